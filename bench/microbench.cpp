@@ -0,0 +1,308 @@
+#include "config.hpp"
+#include "model.hpp"
+#include "presenter.hpp"
+#include "renderer.hpp"
+#include "surface.hpp"
+#include "triangulate.hpp"
+#include <fcntl.h>
+#include <ncurses.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// times the loaders, the triangulator, the rasterizer and the presenters in isolation.
+// prints one tab-separated line per benchmark, in a fixed order:
+//   name  iterations  median_ns  min_ns
+// times are per operation over SAMPLES batches, each batch running at least MIN_BATCH
+namespace fs = std::filesystem;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int SAMPLES = 7;
+    constexpr auto MIN_BATCH = std::chrono::milliseconds(20);
+
+    std::vector<std::string> filters;
+
+    bool selected(const std::string& name) {
+        if (filters.empty()) return true;
+        return std::any_of(filters.begin(), filters.end(), [&](const std::string& f) {
+            return name.find(f) != std::string::npos;
+        });
+    }
+
+    // runs op in batches sized to take at least MIN_BATCH and reports the per-op time of
+    // the median and fastest batch
+    void measure(const std::string& name, const std::function<void()>& op) {
+        if (!selected(name)) return;
+
+        op();  // warm caches and lazily sized buffers
+        long iterations = 1;
+        while (true) {
+            auto start = Clock::now();
+            for (long i = 0; i < iterations; ++i) op();
+            if (Clock::now() - start >= MIN_BATCH) break;
+            iterations *= 2;
+        }
+
+        std::vector<double> ns(SAMPLES);
+        for (double& sample : ns) {
+            auto start = Clock::now();
+            for (long i = 0; i < iterations; ++i) op();
+            sample = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+        }
+        std::sort(ns.begin(), ns.end());
+        std::printf("%s\t%ld\t%.0f\t%.0f\n", name.c_str(), iterations, ns[SAMPLES / 2], ns[0]);
+        std::fflush(stdout);
+    }
+
+    // binary STL of a loaded model, undoing loadFromStl's axis swap and winding flip so the
+    // round trip gives back the same triangles
+    bool writeBinaryStl(const Model& m, const std::string& path) {
+        FILE* out = std::fopen(path.c_str(), "wb");
+        if (!out) return false;
+        char header[80] = "voxcii microbench";
+        uint32_t count = (uint32_t)m.faces.size();
+        std::fwrite(header, 1, sizeof(header), out);
+        std::fwrite(&count, 4, 1, out);
+        for (const Face& f : m.faces) {
+            float record[12] = {};
+            const int order[3] = {f.idxs[0], f.idxs[2], f.idxs[1]};
+            for (int k = 0; k < 3; ++k) {
+                const Vec3& v = m.vertices[order[k]];
+                record[3 + k * 3] = v.x;
+                record[4 + k * 3] = v.z;
+                record[5 + k * 3] = v.y;
+            }
+            uint16_t attribute = 0;
+            std::fwrite(record, 4, 12, out);
+            std::fwrite(&attribute, 2, 1, out);
+        }
+        return std::fclose(out) == 0;
+    }
+
+    bool writeAsciiStl(const Model& m, const std::string& path) {
+        FILE* out = std::fopen(path.c_str(), "w");
+        if (!out) return false;
+        std::fprintf(out, "solid voxcii\n");
+        for (const Face& f : m.faces) {
+            std::fprintf(out, "facet normal 0 0 0\n outer loop\n");
+            const int order[3] = {f.idxs[0], f.idxs[2], f.idxs[1]};
+            for (int k = 0; k < 3; ++k) {
+                const Vec3& v = m.vertices[order[k]];
+                std::fprintf(out, "  vertex %g %g %g\n", v.x, v.z, v.y);
+            }
+            std::fprintf(out, " endloop\nendfacet\n");
+        }
+        std::fprintf(out, "endsolid voxcii\n");
+        return std::fclose(out) == 0;
+    }
+
+    void benchLoaders(const std::string& models_dir) {
+        std::vector<fs::path> objs;
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(models_dir, ec)) {
+            if (entry.path().extension() == ".obj") objs.push_back(entry.path());
+        }
+        std::sort(objs.begin(), objs.end());
+        if (objs.empty()) std::cerr << "warning: no .obj models in " << models_dir << "\n";
+
+        fs::path tmp = fs::temp_directory_path() / "voxcii-microbench";
+        fs::create_directories(tmp, ec);
+
+        for (const fs::path& obj : objs) {
+            std::string stem = obj.stem().string();
+            std::string path = obj.string();
+            measure("load/obj/" + stem, [&] { Model::loadFromObj(path, false); });
+            measure("load/obj-color/" + stem, [&] { Model::loadFromObj(path, true); });
+
+            Model m = Model::loadFromObj(path, false);
+            std::string binary = (tmp / (stem + ".stl")).string();
+            std::string ascii = (tmp / (stem + "-ascii.stl")).string();
+            if (writeBinaryStl(m, binary)) measure("load/stl/" + stem, [&] { Model::loadFromStl(binary); });
+            if (writeAsciiStl(m, ascii)) measure("load/stl-ascii/" + stem, [&] { Model::loadFromStl(ascii); });
+        }
+        fs::remove_all(tmp, ec);
+    }
+
+    std::vector<Vec3> convexPolygon(int n) {
+        std::vector<Vec3> pts;
+        for (int i = 0; i < n; ++i) {
+            float a = 6.2831853f * i / n;
+            pts.emplace_back(std::cos(a), std::sin(a), 0);
+        }
+        return pts;
+    }
+
+    // every other vertex pulled in, so half of them are reflex
+    std::vector<Vec3> starPolygon(int n) {
+        std::vector<Vec3> pts;
+        for (int i = 0; i < n; ++i) {
+            float a = 6.2831853f * i / n;
+            float r = i % 2 ? 0.4f : 1.0f;
+            pts.emplace_back(r * std::cos(a), r * std::sin(a), 0);
+        }
+        return pts;
+    }
+
+    // a comb of narrow teeth: long reflex chains where most ears are blocked
+    std::vector<Vec3> combPolygon(int teeth) {
+        std::vector<Vec3> pts = {{0, 0, 0}, {(float)teeth, 0, 0}};
+        for (int i = teeth - 1; i >= 0; --i) {
+            pts.emplace_back(i + 1.0f, 3, 0);
+            pts.emplace_back(i + 0.5f, 3, 0);
+            pts.emplace_back(i + 0.5f, 1, 0);
+            pts.emplace_back((float)i, 1, 0);
+        }
+        return pts;
+    }
+
+    void benchTriangulate() {
+        Triangulator triangulator;
+        std::vector<int> tris;
+        auto run = [&](const std::string& name, const std::vector<Vec3>& pts) {
+            measure("triangulate/" + name + "/" + std::to_string(pts.size()), [&] {
+                tris.clear();
+                triangulator.triangulate(pts, tris);
+            });
+        };
+        run("convex", convexPolygon(8));
+        run("convex", convexPolygon(1000));
+        run("star", starPolygon(8));
+        run("star", starPolygon(1000));
+        run("comb", combPolygon(250));
+    }
+
+    template <unsigned F>
+    void benchRaster(Surface& surface, const std::string& mode, const char* features) {
+        float lw = surface.getLogicalWidth(), lh = surface.getLogicalHeight();
+        float cw = lw / surface.getWidth(), ch = lh / surface.getHeight();
+        // front-facing on screen (y down); each draw is nearer than the last so every cell passes
+        // the depth test and the hierarchical depth test never rejects
+        struct Shape {
+            const char* name;
+            Triangle tri;
+        };
+        const Shape shapes[] = {
+            {"small", {{10 * cw, 10 * ch, 0}, {10 * cw, 13 * ch, 0}, {13 * cw, 10 * ch, 0}}},
+            {"large", {{0, 0, 0}, {0, 2 * lh, 0}, {2 * lw, 0, 0}}},
+            {"sliver", {{0, 0, 0}, {lw - cw, lh, 0}, {lw, lh - ch, 0}}},
+        };
+        float z = 1e6f;
+        for (const Shape& s : shapes) {
+            if (Surface::backfacing(s.tri)) std::cerr << "warning: " << s.name << " triangle is culled\n";
+            measure("raster/" + mode + "/" + features + "/" + s.name, [&] {
+                if (--z < 1) {
+                    surface.clear();
+                    z = 1e6f;
+                }
+                Triangle t = s.tri;
+                t.p1.z = t.p2.z = t.p3.z = z;
+                surface.drawTriangle<F>(t, '#', 0);
+            });
+        }
+    }
+
+    void benchSurface() {
+        Config cfg;
+        for (RasterMode raster : {RasterMode::Scanline, RasterMode::HalfSpace}) {
+            cfg.raster = raster;
+            Renderer renderer(cfg);
+            Surface surface = renderer.makeSurface(160, 48);
+            surface.clear();
+            std::string mode = raster == RasterMode::Scanline ? "scanline" : "halfspace";
+            benchRaster<0>(surface, mode, "mono");
+            benchRaster<RASTER_COLOR>(surface, mode, "color");
+        }
+
+        Renderer renderer(cfg);
+        for (auto [w, h] : {std::pair{80, 24}, std::pair{400, 120}}) {
+            Surface surface = renderer.makeSurface(w, h);
+            std::string size = std::to_string(w) + "x" + std::to_string(h);
+            measure("clear/mono/" + size, [&] { surface.clear(' ', 0); });
+            measure("clear/color/" + size, [&] { surface.clear(); });
+        }
+    }
+
+    // ncurses and the ANSI backend writing to /dev/null; two rendered frames alternate so
+    // every present has changes to send
+    void benchPresenters(const std::string& models_dir) {
+        if (!selected("present/")) return;
+        std::string path = (fs::path(models_dir) / "teapot.obj").string();
+        Config cfg;
+        cfg.color = true;
+        Scene scene = Scene::load(path, {true, false, false});
+        if (scene.instances.empty()) {
+            std::cerr << "warning: presenters need " << path << "\n";
+            return;
+        }
+        Renderer renderer(cfg);
+        std::vector<Surface> frames = {renderer.makeSurface(160, 48), renderer.makeSurface(160, 48)};
+        renderer.render(scene, animatedView(0.0f, 1.0f), frames[0]);
+        renderer.render(scene, animatedView(0.5f, 1.0f), frames[1]);
+
+        FILE* out = std::fopen("/dev/null", "w");
+        FILE* in = std::fopen("/dev/null", "r");
+        SCREEN* screen = out && in ? newterm("xterm-256color", out, in) : nullptr;
+        if (!screen) {
+            std::cerr << "warning: no null terminal, skipping presenters\n";
+        } else {
+            set_term(screen);
+            resizeterm(48, 160);
+            start_color();
+            for (short i = 1; i <= (short)scene.materials.size() && i < COLOR_PAIRS; ++i) init_pair(i, i % COLORS, 0);
+
+            for (bool color : {false, true}) {
+                NCursesPresenter presenter;
+                int frame = 0;
+                measure(std::string("present/ncurses/") + (color ? "color" : "mono"), [&] {
+                    presenter.present(frames[frame ^= 1], color);
+                    refresh();
+                });
+                clear();
+            }
+            endwin();
+            delscreen(screen);
+        }
+        if (out) std::fclose(out);
+        if (in) std::fclose(in);
+
+        int null_fd = open("/dev/null", O_WRONLY);
+        for (bool color : {false, true}) {
+            AnsiPresenter presenter(null_fd);
+            int frame = 0;
+            measure(std::string("present/ansi/") + (color ? "color" : "mono"), [&] {
+                presenter.present(frames[frame ^= 1], color ? &scene.materials : nullptr);
+            });
+        }
+        if (null_fd >= 0) close(null_fd);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string models_dir = "models";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--models" && i + 1 < argc) models_dir = argv[++i];
+        else if (arg == "-h" || arg == "--help") {
+            std::cerr << "Usage: " << argv[0] << " [--models <dir>] [filter...]\n";
+            std::cerr << "Runs the benchmarks whose names contain any filter (all by default)\n";
+            return 1;
+        } else filters.push_back(arg);
+    }
+
+    std::printf("name\titerations\tmedian_ns\tmin_ns\n");
+    benchLoaders(models_dir);
+    benchTriangulate();
+    benchSurface();
+    benchPresenters(models_dir);
+    return 0;
+}
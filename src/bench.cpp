@@ -0,0 +1,124 @@
+#include "bench.hpp"
+#include "renderer.hpp"
+#include "stream_loader.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double msSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // nearest-rank percentile of sorted samples
+    double percentile(const std::vector<double>& sorted, double p) {
+        size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    std::string jsonEscape(const std::string& s) {
+        std::string out;
+        for (char c : s) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out;
+    }
+}
+
+int runBench(const Config& cfg) {
+    int w = cfg.w ? cfg.w : 160;
+    int h = cfg.h ? cfg.h : 48;
+
+    Renderer renderer(cfg);
+    Surface surface = renderer.makeSurface(w, h);
+
+    // reads fresh caches, but leaves no new .vxc files next to the models
+    LoadOptions opts = loadOptions(cfg);
+    opts.write_cache = false;
+
+    auto load_start = Clock::now();
+    Scene scene;
+    bool streamed = cfg.stream && !Scene::isDescription(cfg.input_file);
+    double first_ms = 0;
+    int stream_frames = 0;
+    if (streamed) {
+        // redraw whenever a chunk arrives, like the viewer does while loading
+        StreamLoader stream(cfg.input_file, opts, cfg.resident);
+        while (stream.isOpen() && !stream.done()) {
+            if (!stream.poll(scene)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            renderer.render(scene, animatedView(0, cfg.zoom / 100.0f), surface);
+            ++stream_frames;
+            if (first_ms == 0 && scene.faceCount() > 0) first_ms = msSince(load_start);
+        }
+    } else {
+        scene = Scene::load(cfg.input_file, opts);
+    }
+    double load_ms = msSince(load_start);
+
+    if (scene.faceCount() == 0) {
+        std::cerr << "Error: No vertices loaded.\n";
+        return 1;
+    }
+
+    // deterministic rotation schedule: frame i is shown at i / fps seconds
+    std::vector<double> frame_ms(cfg.bench_frames);
+    RasterStats pixels;
+    for (int i = 0; i < cfg.bench_frames; ++i) {
+        View view = animatedView((float)i / cfg.fps, cfg.zoom / 100.0f);
+        auto start = Clock::now();
+        pixels += renderer.render(scene, view, surface);
+        frame_ms[i] = msSince(start);
+    }
+
+    double total_ms = 0;
+    for (double t : frame_ms) total_ms += t;
+    std::vector<double> sorted = frame_ms;
+    std::sort(sorted.begin(), sorted.end());
+
+    int frames = cfg.bench_frames;
+    double mean = total_ms / frames;
+    // a tiny scene on a coarse clock can time every frame as 0
+    double tris_per_sec = total_ms > 0 ? (double)scene.faceCount() * frames / (total_ms / 1000.0) : 0.0;
+
+    if (cfg.json) {
+        std::printf("{\"model\":\"%s\",\"vertices\":%zu,\"triangles\":%zu,\"width\":%d,\"height\":%d,"
+                    "\"frames\":%d,\"threads\":%d,\"raster\":\"%s\",\"supersample\":\"%dx%d\",\"prepass\":%s,\"load_ms\":%.3f,"
+                    "\"frame_ms\":{\"mean\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f},"
+                    "\"triangles_per_sec\":%.0f,\"pixels_tested\":%llu,\"pixels_written\":%llu,"
+                    "\"triangles_culled\":%llu,\"triangles_occluded\":%llu,\"stream_first_ms\":%.3f,\"stream_frames\":%d}\n",
+                    jsonEscape(cfg.input_file).c_str(), scene.vertexCount(), scene.faceCount(), w, h,
+                    frames, cfg.threads, cfg.raster == RasterMode::HalfSpace ? "halfspace" : "scanline", cfg.ss_x, cfg.ss_y,
+                    cfg.prepass ? "true" : "false", load_ms,
+                    mean, percentile(sorted, 50), percentile(sorted, 95), percentile(sorted, 99), sorted.back(),
+                    tris_per_sec, (unsigned long long)pixels.tested, (unsigned long long)pixels.written,
+                    (unsigned long long)pixels.culled, (unsigned long long)pixels.occluded, first_ms, stream_frames);
+    } else {
+        std::printf("model       %s (%zu vertices, %zu triangles, %zu instance(s))\n", cfg.input_file.c_str(),
+                    scene.vertexCount(), scene.faceCount(), scene.instances.size());
+        std::printf("surface     %dx%d, %d frames, %d thread(s), %s, %dx%d samples%s\n", w, h, frames, cfg.threads,
+                    cfg.raster == RasterMode::HalfSpace ? "halfspace" : "scanline", cfg.ss_x, cfg.ss_y,
+                    cfg.prepass ? ", depth prepass" : "");
+        std::printf("load        %.3f ms\n", load_ms);
+        if (streamed) {
+            std::printf("stream      first triangles on screen after %.3f ms, %d redraws while loading\n", first_ms, stream_frames);
+        }
+        std::printf("frame       mean %.4f ms  p50 %.4f  p95 %.4f  p99 %.4f  max %.4f\n",
+                    mean, percentile(sorted, 50), percentile(sorted, 95), percentile(sorted, 99), sorted.back());
+        std::printf("throughput  %.2f Mtri/s, %.0f fps\n", tris_per_sec / 1e6, mean > 0 ? 1000.0 / mean : 0.0);
+        std::printf("pixels      %.0f written/frame, %.0f tested/frame\n", 
+                    (double)pixels.written / frames, (double)pixels.tested / frames);
+        std::printf("culled      %.0f back-facing, %.0f occluded triangles/frame\n",
+                    (double)pixels.culled / frames, (double)pixels.occluded / frames);
+    }
+    return 0;
+}
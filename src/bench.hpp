@@ -0,0 +1,6 @@
+#pragma once
+#include "config.hpp"
+
+// renders cfg.bench_frames frames offscreen (no ncurses, no frame pacing)
+// and prints load and frame time statistics
+int runBench(const Config& cfg);
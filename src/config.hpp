@@ -0,0 +1,45 @@
+#pragma once
+#include "model.hpp"
+#include "surface.hpp"
+#include <string>
+#include <vector>
+
+struct Config {
+    std::string input_file;
+    std::vector<std::string> inputs;
+    int w = 0, h = 0;
+    int fps = 20;
+    int threads = 1;
+    RasterMode raster = RasterMode::Scanline;
+    int ss_x = 1, ss_y = 1;  // supersampling grid per cell
+    bool prepass = false;    // depth-only pass before shading
+    bool adaptive = false;   // trade render resolution for holding fps
+    float zoom = 100.0f;
+    bool interactive = false;
+    bool color = false;
+    bool ansi = false;  // direct truecolor escapes instead of ncurses
+    bool weld = false;
+    bool cache = true;
+    bool convert = false;
+    bool stream = false;  // draw while a background thread loads the model
+    size_t resident = 0;  // streamed triangle budget, 0 keeps the full mesh
+    int lod = -1;  // forced level of detail, -1 picks one per frame
+    int bench_frames = 0;
+    std::string export_path;  // headless recording of the animation, empty to run the viewer
+    bool export_text = false;  // a directory of text frames instead of asciicast
+    float range_from = 0, range_to = 0;  // animation seconds to export; an empty range is one turn
+    bool json = false;
+    bool hud = false;
+    std::string trace_file;
+    std::string chars = ".,':;!+*=#$@";
+    int axes[3] = {0, 1, 2};
+    bool inv[3] = {false, false, false};
+};
+
+inline LoadOptions loadOptions(const Config& cfg) {
+    LoadOptions opts;
+    opts.colors = cfg.color;
+    opts.weld = cfg.weld;
+    opts.cache = cfg.cache;
+    return opts;
+}
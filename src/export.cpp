@@ -0,0 +1,234 @@
+#include "export.hpp"
+#include "presenter.hpp"
+#include "renderer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // animatedView turns at 2 rad/s
+    constexpr float TURN_SECONDS = 3.14159265359f;
+    // finished frames each worker may run ahead of the writer
+    constexpr int FRAMES_AHEAD = 2;
+
+    std::string jsonString(const std::string& s) {
+        std::string out = "\"";
+        for (unsigned char c : s) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (c == '\n') {
+                out += "\\n";
+            } else if (c == '\r') {
+                out += "\\r";
+            } else if (c < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+        return out + "\"";
+    }
+
+    // a frame as terminal output: home the cursor and rewrite every row. material colors
+    // become the same 24-bit foreground escapes AnsiPresenter sends, emitted only where the
+    // color changes
+    void encodeAnsi(const Surface& s, const std::vector<Material>* materials, std::string& out) {
+        out = "\x1b[H";
+        int current = -1;
+        char buf[32];
+        for (int y = 0; y < s.getHeight(); ++y) {
+            const char* glyph = s.glyphRow(y);
+            const int16_t* material = materials ? s.materialRow(y) : nullptr;
+            for (int x = 0; x < s.getWidth(); ++x) {
+                int m = material ? material[x] : -1;
+                if (m != current) {
+                    int32_t rgb = m < 0 ? AnsiPresenter::DEFAULT_COLOR : AnsiPresenter::materialColor((*materials)[m]);
+                    out.append(buf, AnsiPresenter::colorEscape(buf, rgb));
+                    current = m;
+                }
+                out += glyph[x];
+            }
+            if (y + 1 < s.getHeight()) out += "\r\n";
+        }
+        if (current >= 0) out += "\x1b[39m";
+    }
+
+    void encodeText(const Surface& s, std::string& out) {
+        out.clear();
+        for (int y = 0; y < s.getHeight(); ++y) {
+            out.append(s.glyphRow(y), s.getWidth());
+            out += '\n';
+        }
+    }
+
+    // renders frames [0, count) on every core and hands them to write in frame order; false
+    // when write fails. workers stay at most FRAMES_AHEAD frames each in front of the writer,
+    // so memory does not grow with the length of the export
+    bool renderFrames(const Scene& scene, const Config& cfg, int w, int h, int count, bool text,
+                      const std::function<bool(int, const std::string&)>& write) {
+        int workers = std::clamp((int)std::thread::hardware_concurrency(), 1, std::max(count, 1));
+        int window = workers * FRAMES_AHEAD;
+        std::vector<std::string> slots(window);
+        std::vector<char> ready(window, 0);
+        std::mutex mtx;
+        std::condition_variable cv;
+        int next = 0, written = 0;
+        bool failed = false;
+
+        // one frame per worker at a time, so each renderer rasterizes on its own thread
+        Config frame_cfg = cfg;
+        frame_cfg.threads = 1;
+        const std::vector<Material>* materials = cfg.color ? &scene.materials : nullptr;
+
+        auto worker = [&]() {
+            Renderer renderer(frame_cfg);
+            Surface surface = renderer.makeSurface(w, h);
+            std::string frame;
+            while (true) {
+                int i;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [&] { return failed || next >= count || next < written + window; });
+                    if (failed || next >= count) return;
+                    i = next++;
+                }
+
+                float t = cfg.range_from + (float)i / cfg.fps;
+                renderer.render(scene, animatedView(t, cfg.zoom / 100.0f), surface);
+                if (text) encodeText(surface, frame);
+                else encodeAnsi(surface, materials, frame);
+
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    slots[i % window].swap(frame);
+                    ready[i % window] = 1;
+                }
+                cv.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int k = 0; k < workers; ++k) threads.emplace_back(worker);
+
+        // the writer recycles each slot's buffer once its frame is out
+        std::string frame;
+        for (int i = 0; i < count && !failed; ++i) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&] { return ready[i % window] != 0; });
+                frame.swap(slots[i % window]);
+                ready[i % window] = 0;
+            }
+            bool ok = write(i, frame);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                written = i + 1;
+                failed = !ok;
+            }
+            cv.notify_all();
+        }
+
+        for (auto& t : threads) t.join();
+        return !failed;
+    }
+
+    // asciicast v2: a header line, then one [time, "o", data] event per frame
+    bool exportCast(const Scene& scene, const Config& cfg, int w, int h, int count, const std::string& path) {
+        FILE* out = std::fopen(path.c_str(), "w");
+        if (!out) return false;
+
+        std::fprintf(out, "{\"version\": 2, \"width\": %d, \"height\": %d, \"timestamp\": %lld, "
+                          "\"env\": {\"TERM\": \"xterm-256color\"}, \"title\": %s}\n",
+                     w, h, (long long)std::time(nullptr), jsonString(fs::path(cfg.input_file).filename().string()).c_str());
+        // hide the cursor and start from a blank screen
+        std::fprintf(out, "[0.000000, \"o\", %s]\n", jsonString("\x1b[?25l\x1b[2J").c_str());
+
+        bool ok = renderFrames(scene, cfg, w, h, count, false, [&](int i, const std::string& frame) {
+            return std::fprintf(out, "[%.6f, \"o\", %s]\n", (double)i / cfg.fps, jsonString(frame).c_str()) > 0;
+        });
+        std::fprintf(out, "[%.6f, \"o\", %s]\n", (double)count / cfg.fps, jsonString("\x1b[?25h").c_str());
+        return std::fclose(out) == 0 && ok;
+    }
+
+    // one NNNNN.txt per frame
+    bool exportText(const Scene& scene, const Config& cfg, int w, int h, int count, const std::string& dir) {
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+        if (ec) return false;
+
+        return renderFrames(scene, cfg, w, h, count, true, [&](int i, const std::string& frame) {
+            char name[16];
+            std::snprintf(name, sizeof(name), "%05d.txt", i);
+            FILE* out = std::fopen((fs::path(dir) / name).string().c_str(), "w");
+            if (!out) return false;
+            bool ok = std::fwrite(frame.data(), 1, frame.size(), out) == frame.size();
+            return std::fclose(out) == 0 && ok;
+        });
+    }
+}
+
+int runExport(const Config& cfg) {
+    int w = cfg.w ? cfg.w : 80;
+    int h = cfg.h ? cfg.h : 24;
+    float to = cfg.range_to > cfg.range_from ? cfg.range_to : cfg.range_from + TURN_SECONDS;
+    int count = std::max(1, (int)std::lround((to - cfg.range_from) * cfg.fps));
+
+    // several inputs share the output directory, one recording each
+    bool batch = cfg.inputs.size() > 1;
+    if (batch) {
+        std::error_code ec;
+        fs::create_directories(cfg.export_path, ec);
+        if (ec) {
+            std::cerr << "Error: Failed to create " << cfg.export_path << "\n";
+            return 1;
+        }
+    }
+
+    // reads fresh caches, but leaves no new .vxc files next to the models
+    LoadOptions opts = loadOptions(cfg);
+    opts.write_cache = false;
+
+    int failed = 0;
+    for (const auto& file : cfg.inputs) {
+        auto start = Clock::now();
+        Config model_cfg = cfg;
+        model_cfg.input_file = file;
+        Scene scene = Scene::load(file, opts);
+        if (scene.instances.empty()) {
+            std::cerr << "Error: No vertices loaded from " << file << "\n";
+            ++failed;
+            continue;
+        }
+
+        std::string path = cfg.export_path;
+        if (batch) {
+            path = (fs::path(cfg.export_path) / fs::path(file).stem()).string();
+            if (!cfg.export_text) path += ".cast";
+        }
+        bool ok = cfg.export_text ? exportText(scene, model_cfg, w, h, count, path)
+                                  : exportCast(scene, model_cfg, w, h, count, path);
+        if (!ok) {
+            std::cerr << "Error: Failed to write " << path << "\n";
+            ++failed;
+            continue;
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        std::cout << file << " -> " << path << " (" << count << " frames, " << (int)ms << " ms)\n";
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "config.hpp"
+
+// renders the animation schedule headlessly for every input (cfg.export_path, cfg.range_*,
+// cfg.fps, cfg.w x cfg.h) into an asciicast v2 recording or a directory of text frames.
+// frames render in parallel on all cores and are written in order as they finish
+int runExport(const Config& cfg);
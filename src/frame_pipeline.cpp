@@ -0,0 +1,183 @@
+#include "frame_pipeline.hpp"
+#include "profiler.hpp"
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+    // frames in flight: one rendering, one in the mailbox, one on screen
+    constexpr int FRAME_COUNT = 3;
+    // how often the worker looks for streamed geometry while the model loads
+    constexpr auto STREAM_POLL = std::chrono::milliseconds(50);
+
+    // adaptive resolution: the scale is level / SCALE_LEVELS, between MIN_LEVEL and full
+    // resolution. a step down aims at SCALE_TARGET of the budget; a step up is taken only
+    // when it is predicted to stay under that, and after more frames, so the resolution
+    // does not flicker. render cost is taken to grow with the cell count, which
+    // overestimates the fixed per-frame work
+    constexpr int SCALE_LEVELS = 20;
+    constexpr int MIN_LEVEL = 5;
+    constexpr int DOWN_SETTLE = 4;
+    constexpr int UP_SETTLE = 12;
+    constexpr double SCALE_TARGET = 0.85;
+    constexpr double SCALE_SMOOTHING = 0.3;
+
+    bool earlier(FramePipeline::Clock::time_point a, FramePipeline::Clock::time_point b) {
+        return a != FramePipeline::Clock::time_point{} && (b == FramePipeline::Clock::time_point{} || a < b);
+    }
+}
+
+FramePipeline::FramePipeline(Renderer& renderer, Scene& scene, StreamLoader* stream, int w, int h, double budget_ms)
+    : renderer(renderer), scene(scene), stream(stream), budget_ms(budget_ms), level(SCALE_LEVELS) {
+    frames.reserve(FRAME_COUNT);
+    for (int i = 0; i < FRAME_COUNT; ++i) frames.push_back({renderer.makeSurface(w, h)});
+    for (Frame& f : frames) free_frames.push_back(&f);
+    materials = std::make_shared<const std::vector<Material>>(scene.materials);
+
+    if (pipe(wake) == 0) {
+        fcntl(wake[0], F_SETFL, O_NONBLOCK);
+        fcntl(wake[1], F_SETFL, O_NONBLOCK);
+    }
+    worker = std::thread(&FramePipeline::loop, this);
+}
+
+FramePipeline::~FramePipeline() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_one();
+    worker.join();
+    for (int fd : wake) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+void FramePipeline::request(const Request& r) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        // a replaced request never reached the screen, so its input is still unanswered
+        Clock::time_point input = started != generation ? pending.input : Clock::time_point{};
+        pending = r;
+        if (earlier(input, pending.input)) pending.input = input;
+        ++generation;
+    }
+    cv.notify_one();
+}
+
+const FramePipeline::Frame* FramePipeline::acquire() {
+    std::lock_guard<std::mutex> lock(mtx);
+    char buf[16];
+    while (read(wake[0], buf, sizeof(buf)) > 0) {}
+
+    if (!mailbox) return nullptr;
+    if (shown) free_frames.push_back(shown);
+    shown = std::exchange(mailbox, nullptr);
+    return shown;
+}
+
+int FramePipeline::takeDropped() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return std::exchange(dropped, 0);
+}
+
+void FramePipeline::loop() {
+    uint64_t drawn = 0;
+    while (true) {
+        Request r;
+        uint64_t gen;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            auto ready = [&] { return stopping || generation != drawn; };
+            if (stream && !stream->done()) cv.wait_for(lock, STREAM_POLL, ready);
+            else cv.wait(lock, ready);
+            if (stopping) return;
+            r = pending;
+            gen = started = generation;
+        }
+
+        bool grew = stream && !stream->done() && stream->poll(scene);
+        if (gen == drawn && !grew) continue;
+        drawn = gen;
+        if (scene.materials.size() != materials->size()) {
+            materials = std::make_shared<const std::vector<Material>>(scene.materials);
+        }
+
+        Frame* f;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            f = free_frames.back();
+            free_frames.pop_back();
+        }
+        draw(*f, r);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (mailbox) {
+                // the replaced frame was never shown; this one answers its input too
+                if (earlier(mailbox->input, f->input)) f->input = mailbox->input;
+                free_frames.push_back(mailbox);
+                ++dropped;
+            }
+            mailbox = f;
+        }
+        // a full pipe means a wakeup is pending already
+        char c = 1;
+        [[maybe_unused]] ssize_t n = write(wake[1], &c, 1);
+    }
+}
+
+void FramePipeline::draw(Frame& f, const Request& r) {
+    if (f.surface.getWidth() != r.w || f.surface.getHeight() != r.h) f.surface = renderer.makeSurface(r.w, r.h);
+
+    // a frame replaced in the mailbox is never shown, so its profile is held back with it
+    Profiler& prof = Profiler::get();
+    if (prof.active()) prof.beginCapture(&f.profile);
+    else f.profile.entries.clear();
+
+    float scale = (float)level / SCALE_LEVELS;
+    auto start = Clock::now();
+    if (level < SCALE_LEVELS) {
+        if (!reduced || reduced_w != r.w || reduced_h != r.h || reduced_level != level) {
+            reduced = std::make_unique<Surface>(renderer.makeSurface(r.w, r.h, scale));
+            reduced_w = r.w;
+            reduced_h = r.h;
+            reduced_level = level;
+        }
+        renderer.render(scene, r.view, *reduced);
+        f.surface.upscale(*reduced);
+    } else {
+        renderer.render(scene, r.view, f.surface);
+    }
+    f.scale = scale;
+    if (budget_ms > 0) adapt(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    prof.endCapture();
+
+    if (r.hud) {
+        auto lines = prof.hudLines();
+        for (size_t i = 0; i < lines.size(); ++i) f.surface.drawText(0, (int)i, lines[i]);
+    }
+    if (stream && !stream->done()) {
+        f.surface.drawText(0, f.surface.getHeight() - 1, "loading " + std::to_string((int)(stream->progress() * 100)) + "%");
+    }
+    f.input = r.input;
+    f.materials = materials;
+}
+
+void FramePipeline::adapt(double ms) {
+    render_ms = level_frames ? render_ms + (ms - render_ms) * SCALE_SMOOTHING : ms;
+    if (++level_frames < DOWN_SETTLE) return;
+
+    int next = level;
+    if (render_ms > budget_ms) {
+        int fit = (int)(level * std::sqrt(SCALE_TARGET * budget_ms / render_ms));
+        next = std::max(MIN_LEVEL, std::min(level - 1, fit));
+    } else if (level < SCALE_LEVELS && level_frames >= UP_SETTLE) {
+        double growth = (double)(level + 1) * (level + 1) / (level * level);
+        if (render_ms * growth < SCALE_TARGET * budget_ms) next = level + 1;
+    }
+    if (next != level) {
+        level = next;
+        level_frames = 0;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "profiler.hpp"
+#include "renderer.hpp"
+#include "scene.hpp"
+#include "stream_loader.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// renders on a worker thread while the caller presents the previous frame, so a frame
+// takes max(render, present) instead of their sum. three frames rotate between the worker,
+// a one-slot mailbox and the screen; a finished frame replaces an unpresented one in the
+// mailbox, dropping it when output can't keep up. the scene (and stream) belong to the
+// worker while the pipeline runs. with a frame budget the worker renders at a reduced
+// internal resolution while frames run over it, upscaling to the requested size
+class FramePipeline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Request {
+        View view;
+        int w = 0, h = 0;
+        bool hud = false;
+        // when the oldest input this view answers was read, for latency; zero if none
+        Clock::time_point input{};
+    };
+
+    struct Frame {
+        Surface surface;
+        Clock::time_point input{};
+        std::shared_ptr<const std::vector<Material>> materials;
+        float scale = 1.0f;  // internal resolution it was rendered at
+        // stages and counters of rendering it, for the presenter to add when it is shown
+        Profiler::Capture profile;
+    };
+
+    // budget_ms is the render time per frame to hold, 0 always renders at full resolution
+    FramePipeline(Renderer& renderer, Scene& scene, StreamLoader* stream, int w, int h, double budget_ms = 0);
+    ~FramePipeline();
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    // replaces any request the worker has not started; input stamps carry over
+    void request(const Request& r);
+    // newest finished frame, or nullptr when none arrived since the last call. the frame
+    // stays valid until the next successful acquire
+    const Frame* acquire();
+    // becomes readable when a frame is waiting, for poll() alongside stdin
+    int readyFd() const { return wake[0]; }
+    // frames replaced in the mailbox before they were shown, since the last call
+    int takeDropped();
+
+private:
+    void loop();
+    void draw(Frame& f, const Request& r);
+    // picks the next internal resolution from the time the last frame took to render
+    void adapt(double render_ms);
+
+    Renderer& renderer;
+    Scene& scene;
+    StreamLoader* stream;
+
+    std::vector<Frame> frames;
+    std::vector<Frame*> free_frames;
+    Frame* mailbox = nullptr;
+    Frame* shown = nullptr;
+    std::shared_ptr<const std::vector<Material>> materials;
+
+    // adaptive resolution, touched only by the worker
+    double budget_ms;
+    int level;             // internal resolution in steps of 1 / SCALE_LEVELS
+    int level_frames = 0;  // drawn at the current level
+    double render_ms = 0;  // smoothed over those frames
+    std::unique_ptr<Surface> reduced;
+    int reduced_w = 0, reduced_h = 0, reduced_level = 0;  // what reduced was made for
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    Request pending;
+    uint64_t generation = 0;  // of pending, bumped by request()
+    uint64_t started = 0;     // generation the worker last picked up
+    int dropped = 0;
+    bool stopping = false;
+    int wake[2] = {-1, -1};
+    std::thread worker;
+};
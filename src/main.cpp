@@ -1,6 +1,18 @@
+#include "config.hpp"
 #include "model.hpp"
+#include "scene.hpp"
 #include "surface.hpp"
+#include "renderer.hpp"
+#include "mesh_cache.hpp"
+#include "stream_loader.hpp"
+#include "frame_pipeline.hpp"
+#include "presenter.hpp"
+#include "bench.hpp"
+#include "export.hpp"
+#include "profiler.hpp"
+#include "terminal.hpp"
 #include <ncurses.h>
+#include <poll.h>
 #include <unistd.h>
 #include <iostream>
 #include <chrono>
@@ -8,72 +20,86 @@
 #include <thread>
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <optional>
+#include <charconv>
 
-struct Config {
-    std::string input_file;
-    int w = 0, h = 0;
-    int fps = 20;
-    float zoom = 100.0f;
-    bool interactive = false;
-    bool color = false;
-    std::string chars = ".,':;!+*=#$@";
-    int axes[3] = {0, 1, 2};
-    bool inv[3] = {false, false, false};
-};
-
-char getLumChar(const Vec3& norm, const Vec3& light, const std::string& chars) {
-    float sim = norm.dot(light) * 0.5f + 0.5f;
-    size_t idx = std::clamp((size_t)std::round((chars.size() - 1) * sim), (size_t)0, chars.size() - 1);
-    return chars[idx];
-}
+// longest an idle interactive viewer sleeps in getch
+constexpr int IDLE_TIMEOUT_MS = 1000;
 
-Vec3 mapToSurface(const Vec3& v, const Surface& surf, float lw, float lh, float zoom) {
-    return {
-        0.5f * lw + 0.5f * v.x * zoom,
-        0.5f * lh - 0.5f * v.y * zoom,
-        0.5f + 0.5f * v.z * zoom
-    };
+// the whole argument as a number: false for junk, trailing characters, overflow, or a sign
+// on an unsigned type
+template <typename T>
+bool parseNumber(const char* s, T& out) {
+    const char* end = s + std::strlen(s);
+    auto [p, ec] = std::from_chars(s, end, out);
+    return ec == std::errc() && p == end && p != s;
 }
 
-void run(Model& model, Config& cfg) {
-    initscr();
-    noecho();
-    curs_set(0);
-    timeout(0);
-    keypad(stdscr, TRUE);
-    
-    if (cfg.w == 0) getmaxyx(stdscr, cfg.h, cfg.w);
+// stream, when given, keeps adding to scene while the viewer runs
+void run(Scene& scene, Config& cfg, StreamLoader* stream) {
+    // --ansi writes escapes straight to a raw terminal; otherwise ncurses owns the screen
+    std::optional<RawTerminal> term;
+    if (cfg.ansi) {
+        term.emplace();
+        if (!term->isOpen()) {
+            std::cerr << "Error: --ansi needs a terminal\n";
+            return;
+        }
+    } else {
+        initscr();
+        noecho();
+        curs_set(0);
+        timeout(0);
+        keypad(stdscr, TRUE);
+    }
+
+    // follow the terminal size unless --size fixed it
+    bool fit_terminal = cfg.w == 0;
+    auto fitTerminal = [&]() {
+        if (term) {
+            if (!term->size(cfg.w, cfg.h)) {
+                cfg.w = 80;
+                cfg.h = 24;
+            }
+        } else {
+            getmaxyx(stdscr, cfg.h, cfg.w);
+        }
+    };
+    if (fit_terminal) fitTerminal();
     
-    // initialize colors
-    if (cfg.color) {
-        start_color();
-        if (can_change_color()) {
-            for(size_t i=0; i < model.materials.size(); ++i) {
-                auto& m = model.materials[i];
+    // initialize colors, again whenever streaming brings new materials
+    size_t colored = 0;
+    auto initColors = [&](const std::vector<Material>& materials) {
+        if (cfg.color && can_change_color()) {
+            for(size_t i=colored; i < materials.size(); ++i) {
+                auto& m = materials[i];
                 // scale 0-1 float to 0-1000 short for ncurses
                 init_color(i+1, (short)(m.kd[0]*1000), (short)(m.kd[1]*1000), (short)(m.kd[2]*1000));
                 init_pair(i+1, i+1, 0);
             }
         }
-    }
+        colored = materials.size();
+    };
+    if (cfg.color && !term) start_color();
 
-    // aspect ratio correction for characters
-    float logical_h = 1.0f;
-    float logical_w = (float)cfg.w / (cfg.h * 1.8f); 
-    
-    Surface surface(cfg.w, cfg.h, logical_w, logical_h);
+    // frames are rendered on the pipeline's thread; curses stays on this one
+    Renderer renderer(cfg);
+    FramePipeline pipeline(renderer, scene, stream, cfg.w, cfg.h, cfg.adaptive ? 1000.0 / cfg.fps : 0);
+    NCursesPresenter presenter;
+    AnsiPresenter ansi(STDOUT_FILENO);
+    Profiler& prof = Profiler::get();
     
     // state variables
-    float az = 0, al = 0;
-    float zoom = cfg.zoom / 100.0f;
+    View view;
+    view.zoom = cfg.zoom / 100.0f;
     bool running = true;
-    Vec3 light = Vec3(1, -1, 0).normalize();
-    
-    // animation constants
-    const float PI = 3.14159265359f;
-    const float GOLDEN_RATIO = 1.6180339887f;
-    const float az_speed = 2.0f;
-    const float al_speed = GOLDEN_RATIO * 0.25f;
+
+    // request a frame only when the view, the terminal or the overlay changed
+    bool dirty = true;
+    View requested;
+    // first key not yet answered by a requested frame
+    FramePipeline::Clock::time_point input{};
 
     auto start_time = std::chrono::steady_clock::now();
     auto next_frame = start_time;
@@ -83,84 +109,123 @@ void run(Model& model, Config& cfg) {
         auto now = std::chrono::steady_clock::now();
         
         // rotation logic
-        if (!cfg.interactive) {
+        if (!cfg.interactive && now >= next_frame) {
             std::chrono::duration<float> elapsed = now - start_time;
-            float t = elapsed.count();
-            
-            az = az_speed * t;
-            // oscillate altitude slightly for 3D effect
-            al = 0.125f * PI * (1.0f - std::sin(al_speed * t)); 
+            view = animatedView(elapsed.count(), view.zoom);
+            next_frame += std::chrono::microseconds(frame_us);
+            // after a late frame the schedule restarts from now rather than rushing the
+            // missed frames out back to back
+            if (next_frame <= now) next_frame = now + std::chrono::microseconds(frame_us);
+            dirty = true;
         }
 
-        // drawing
-        surface.clear();
+        if (dirty || view != requested) {
+            pipeline.request({view, cfg.w, cfg.h, prof.hudVisible(), input});
+            requested = view;
+            dirty = false;
+            input = {};
+        }
 
-        float cos_az = std::cos(az), sin_az = std::sin(az);
-        float cos_al = std::cos(-al), sin_al = std::sin(-al);
+        // present while the next frame renders
+        if (const FramePipeline::Frame* frame = pipeline.acquire()) {
+            prof.add(frame->profile);
+            if (term) {
+                ProfileScope scope("present");
+                if (!ansi.present(frame->surface, cfg.color ? frame->materials.get() : nullptr)) running = false;
+                prof.count("output bytes", ansi.lastBytes());
+            } else {
+                initColors(*frame->materials);
+                {
+                    ProfileScope scope("present");
+                    presenter.present(frame->surface, cfg.color);
+                }
+                {
+                    ProfileScope scope("refresh");
+                    refresh();
+                }
+            }
+            if (frame->input != FramePipeline::Clock::time_point{}) {
+                prof.count("input ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame->input).count());
+            }
+            prof.count("dropped", pipeline.takeDropped());
+            if (cfg.adaptive) prof.count("scale %", frame->scale * 100);
+            prof.endFrame();
+        }
 
-        for (const auto& face : model.faces) {
-            Triangle t = {
-                model.vertices[face.idxs[0]], 
-                model.vertices[face.idxs[1]], 
-                model.vertices[face.idxs[2]]
-            };
-            
-            // rotate
-            auto transform = [&](Vec3 v) {
-                v = v.rotateY(cos_az, sin_az);
-                v = v.rotateX(cos_al, sin_al);
-                return v;
-            };
-
-            t.p1 = transform(t.p1);
-            t.p2 = transform(t.p2);
-            t.p3 = transform(t.p3);
-
-            // lighting (calculate normal after rotation)
-            Vec3 normal = (t.p2 - t.p1).cross(t.p3 - t.p1).normalize();
-            char c = getLumChar(normal * -1.0f, light, cfg.chars);
-
-            // map to screen surface
-            t.p1 = mapToSurface(t.p1, surface, logical_w, logical_h, zoom);
-            t.p2 = mapToSurface(t.p2, surface, logical_w, logical_h, zoom);
-            t.p3 = mapToSurface(t.p3, surface, logical_w, logical_h, zoom);
-            
-            surface.drawTriangle(t, c, face.material_idx);
+        // input handling: the animation waits for its next frame, an idle interactive
+        // view sleeps until a key arrives or a rendered frame is ready
+        int wait_ms = IDLE_TIMEOUT_MS;
+        if (!cfg.interactive) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(next_frame - std::chrono::steady_clock::now());
+            wait_ms = std::max(0, (int)left.count());
         }
+        pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {pipeline.readyFd(), POLLIN, 0}};
+        poll(fds, 2, wait_ms);
 
-        surface.printNCurses(cfg.color);
-        refresh();
+        // apply every queued key before the next request so held keys do not pile up
+        auto readKey = [&]() { return term ? term->readKey() : getch(); };
+        for (int ch = readKey(); ch != ERR; ch = readKey()) {
+            if (input == FramePipeline::Clock::time_point{}) input = std::chrono::steady_clock::now();
+            if (ch == 'q') running = false;
+            if (ch == 'p') {
+                prof.setHud(!prof.hudVisible());
+                dirty = true;
+            }
+            if (ch == KEY_RESIZE) {
+                if (fit_terminal) fitTerminal();
+                if (term) {
+                    ansi.invalidate();
+                } else {
+                    clearok(stdscr, TRUE);
+                    presenter.invalidate();
+                }
+                dirty = true;
+            }
+            
+            if (cfg.interactive) {
+                if (ch == KEY_LEFT) view.az += 0.1f;
+                if (ch == KEY_RIGHT) view.az -= 0.1f;
+                if (ch == KEY_UP) view.al += 0.1f;
+                if (ch == KEY_DOWN) view.al -= 0.1f;
+            }
 
-        // input handling
-        int ch = getch();
-        if (ch == 'q') running = false;
-        
-        if (cfg.interactive) {
-            if (ch == KEY_LEFT) az += 0.1f;
-            if (ch == KEY_RIGHT) az -= 0.1f;
-            if (ch == KEY_UP) al += 0.1f;
-            if (ch == KEY_DOWN) al -= 0.1f;
+            if (ch == '+' || ch == '=') view.zoom *= 1.1f;
+            if (ch == '-') view.zoom *= 0.9f;
+            view.zoom = std::clamp(view.zoom, 0.1f, 10.0f);
         }
-
-        if (ch == '+' || ch == '=') zoom *= 1.1f;
-        if (ch == '-') zoom *= 0.9f;
-        zoom = std::clamp(zoom, 0.1f, 10.0f);
-        
-        // timing
-        next_frame += std::chrono::microseconds(frame_us);
-        std::this_thread::sleep_until(next_frame);
     }
 
-    endwin();
+    if (!term) endwin();
 }
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " [options] file.obj\n";
+        std::cerr << "Usage: " << argv[0] << " [options] file.obj|file.stl|file.scene\n";
         std::cerr << "Options:\n";
         std::cerr << "  -i, --interactive   Manual control (Arrow keys)\n";
         std::cerr << "  -c, --color         Enable colors (if supported)\n";
         std::cerr << "  -z, --zoom <num>    Zoom level (default 100)\n";
+        std::cerr << "  -t, --threads <n>   Rasterizer threads (default 1, 0 = all cores)\n";
+        std::cerr << "  -r, --raster <mode> Rasterizer: scanline (default) or halfspace\n";
+        std::cerr << "      --supersample <NxM>  Shade N x M samples per cell (1-8 each)\n";
+        std::cerr << "      --prepass       Rasterize depth before shading\n";
+        std::cerr << "      --adaptive      Lower the render resolution while frames miss --fps\n";
+        std::cerr << "      --ansi          Draw with 24-bit ANSI escapes instead of ncurses\n";
+        std::cerr << "  -w, --weld          Merge coincident vertices after loading\n";
+        std::cerr << "      --lod <auto|n>  Level of detail (default auto, 0 = full mesh)\n";
+        std::cerr << "      --stream        Draw while the model loads in the background\n";
+        std::cerr << "      --resident <n>  With --stream, keep a clustered copy of about n triangles\n";
+        std::cerr << "      --no-cache      Do not read or write .vxc mesh caches\n";
+        std::cerr << "      --convert       Build .vxc caches for all given files and exit\n";
+        std::cerr << "  -s, --size <WxH>    Render size in cells (default: terminal size)\n";
+        std::cerr << "      --bench <n>     Render n frames offscreen and print timings\n";
+        std::cerr << "      --json          Print --bench results as JSON\n";
+        std::cerr << "      --export <path> Record the animation headlessly (a directory for several files)\n";
+        std::cerr << "      --format <fmt>  Export format: cast (asciicast v2, default) or text (one file per frame)\n";
+        std::cerr << "      --range <a:b>   Export animation seconds a to b (default: one full turn)\n";
+        std::cerr << "      --fps <n>       Animation frame rate (default 20)\n";
+        std::cerr << "      --hud           Show the profiling overlay (toggle with p)\n";
+        std::cerr << "      --trace <file>  Write a Chrome trace-event JSON profile on exit\n";
         return 1;
     }
 
@@ -169,27 +234,170 @@ int main(int argc, char** argv) {
         std::string arg = argv[i];
         if (arg == "--color" || arg == "-c") cfg.color = true;
         else if (arg == "--interactive" || arg == "-i") cfg.interactive = true;
-        else if ((arg=="--zoom" || arg=="-z") && i+1 < argc) cfg.zoom = std::stof(argv[++i]);
-        else if (arg[0] != '-') cfg.input_file = arg;
+        else if (arg == "--weld" || arg == "-w") cfg.weld = true;
+        else if (arg == "--no-cache") cfg.cache = false;
+        else if (arg == "--convert") cfg.convert = true;
+        else if (arg == "--prepass") cfg.prepass = true;
+        else if (arg == "--adaptive") cfg.adaptive = true;
+        else if (arg == "--ansi") cfg.ansi = true;
+        else if (arg == "--stream") cfg.stream = true;
+        else if (arg == "--resident" && i+1 < argc) {
+            cfg.stream = true;
+            if (!parseNumber(argv[++i], cfg.resident)) {
+                std::cerr << "Error: Invalid resident budget '" << argv[i] << "', expected a triangle count\n";
+                return 1;
+            }
+        }
+        else if (arg == "--json") cfg.json = true;
+        else if (arg == "--hud") cfg.hud = true;
+        else if (arg == "--trace" && i+1 < argc) cfg.trace_file = argv[++i];
+        else if (arg == "--bench" && i+1 < argc) {
+            if (!parseNumber(argv[++i], cfg.bench_frames) || cfg.bench_frames <= 0) {
+                std::cerr << "Error: Invalid frame count '" << argv[i] << "'\n";
+                return 1;
+            }
+        }
+        else if (arg == "--export" && i+1 < argc) cfg.export_path = argv[++i];
+        else if (arg == "--format" && i+1 < argc) {
+            std::string format = argv[++i];
+            if (format == "text") cfg.export_text = true;
+            else if (format == "cast") cfg.export_text = false;
+            else {
+                std::cerr << "Error: Unknown export format '" << format << "'\n";
+                return 1;
+            }
+        }
+        else if (arg == "--range" && i+1 < argc) {
+            if (std::sscanf(argv[++i], "%f:%f", &cfg.range_from, &cfg.range_to) != 2 || cfg.range_from < 0 ||
+                cfg.range_to <= cfg.range_from) {
+                std::cerr << "Error: Invalid range '" << argv[i] << "', expected FROM:TO seconds\n";
+                return 1;
+            }
+        }
+        else if (arg == "--fps" && i+1 < argc) {
+            if (!parseNumber(argv[++i], cfg.fps) || cfg.fps <= 0) {
+                std::cerr << "Error: Invalid frame rate '" << argv[i] << "'\n";
+                return 1;
+            }
+        }
+        else if ((arg=="--size" || arg=="-s") && i+1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &cfg.w, &cfg.h) != 2 || cfg.w <= 0 || cfg.h <= 0) {
+                std::cerr << "Error: Invalid size '" << argv[i] << "', expected WxH\n";
+                return 1;
+            }
+        }
+        else if (arg == "--supersample" && i+1 < argc) {
+            if (std::sscanf(argv[++i], "%dx%d", &cfg.ss_x, &cfg.ss_y) != 2 ||
+                cfg.ss_x < 1 || cfg.ss_y < 1 || cfg.ss_x > 8 || cfg.ss_y > 8) {
+                std::cerr << "Error: Invalid supersampling '" << argv[i] << "', expected NxM with 1-8 each\n";
+                return 1;
+            }
+        }
+        else if ((arg=="--zoom" || arg=="-z") && i+1 < argc) {
+            if (!parseNumber(argv[++i], cfg.zoom) || !std::isfinite(cfg.zoom)) {
+                std::cerr << "Error: Invalid zoom '" << argv[i] << "'\n";
+                return 1;
+            }
+        }
+        else if ((arg=="--threads" || arg=="-t") && i+1 < argc) {
+            if (!parseNumber(argv[++i], cfg.threads)) {
+                std::cerr << "Error: Invalid thread count '" << argv[i] << "'\n";
+                return 1;
+            }
+        }
+        else if (arg == "--lod" && i+1 < argc) {
+            std::string lod = argv[++i];
+            if (lod == "auto") cfg.lod = -1;
+            else if (!parseNumber(lod.c_str(), cfg.lod) || cfg.lod < -1) {
+                std::cerr << "Error: Invalid level of detail '" << lod << "'\n";
+                return 1;
+            }
+        }
+        else if ((arg=="--raster" || arg=="-r") && i+1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "halfspace") cfg.raster = RasterMode::HalfSpace;
+            else if (mode == "scanline") cfg.raster = RasterMode::Scanline;
+            else {
+                std::cerr << "Error: Unknown rasterizer '" << mode << "'\n";
+                return 1;
+            }
+        }
+        else if (arg[0] != '-') {
+            cfg.input_file = arg;
+            cfg.inputs.push_back(arg);
+        }
     }
 
     if (cfg.input_file.empty()) return 1;
+    // the stream loader reads one model file and never welds
+    if (cfg.stream && Scene::isDescription(cfg.input_file)) {
+        std::cerr << "Error: --stream and --resident take a single .obj or .stl model, not a scene\n";
+        return 1;
+    }
+    if (cfg.stream && cfg.weld) {
+        std::cerr << "Error: --weld cannot be combined with --stream or --resident\n";
+        return 1;
+    }
+    if (cfg.threads <= 0) cfg.threads = std::max(1u, std::thread::hardware_concurrency());
 
-    Model model;
-    if (cfg.input_file.find(".obj") != std::string::npos) {
-        model = Model::loadFromObj(cfg.input_file, cfg.color);
-        model.invertTriangles(); // fix winding order
-        model.transform(0, 1, 2, false, false, true); // invert z for obj standard
-    } else {
-        model = Model::loadFromStl(cfg.input_file);
+    LoadOptions opts = loadOptions(cfg);
+
+    Profiler& prof = Profiler::get();
+    prof.setHud(cfg.hud);
+    if (!cfg.trace_file.empty()) prof.startTrace(cfg.trace_file);
+
+    if (cfg.convert) {
+        // build caches ahead of time
+        int failed = 0;
+        for (const auto& file : cfg.inputs) {
+            Model model = Model::load(file, {opts.colors, opts.weld, false});
+            CacheKey key;
+            std::string path;
+            if (model.vertices.empty() || !makeCacheKey(file, opts.cacheFlags(), key) || !writeMeshCache(key, model, &path)) {
+                std::cerr << "Error: Failed to convert " << file << "\n";
+                ++failed;
+                continue;
+            }
+            std::cout << file << " -> " << path << "\n";
+        }
+        return failed ? 1 : 0;
     }
-    
-    if (model.vertices.empty()) {
+
+    auto finishTrace = [&]() {
+        if (!prof.finish()) std::cerr << "Error: Failed to write trace " << cfg.trace_file << "\n";
+    };
+
+    if (cfg.bench_frames > 0) {
+        int rc = runBench(cfg);
+        finishTrace();
+        return rc;
+    }
+
+    if (!cfg.export_path.empty()) {
+        int rc = runExport(cfg);
+        finishTrace();
+        return rc;
+    }
+
+    if (cfg.stream && !Scene::isDescription(cfg.input_file)) {
+        Scene scene;  // outlives the loader, which reads the finished mesh
+        StreamLoader stream(cfg.input_file, opts, cfg.resident);
+        if (!stream.isOpen()) {
+            std::cerr << "Error: Failed to open " << cfg.input_file << "\n";
+            return 1;
+        }
+        run(scene, cfg, &stream);
+        finishTrace();
+        return 0;
+    }
+
+    Scene scene = Scene::load(cfg.input_file, opts);
+    if (scene.instances.empty()) {
         std::cerr << "Error: No vertices loaded.\n";
         return 1;
     }
 
-    model.normalize();
-    run(model, cfg);
+    run(scene, cfg, nullptr);
+    finishTrace();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "mapped_file.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        len = (size_t)st.st_size;
+        if (len == 0) {
+            ptr = "";
+            open = true;
+        } else {
+            void* p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, len, MADV_SEQUENTIAL);
+                ptr = static_cast<const char*>(p);
+                open = true;
+            }
+        }
+    }
+    ::close(fd);
+    if (!open) len = 0;
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : ptr(std::exchange(other.ptr, nullptr)), 
+      len(std::exchange(other.len, 0)), 
+      open(std::exchange(other.open, false)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        ptr = std::exchange(other.ptr, nullptr);
+        len = std::exchange(other.len, 0);
+        open = std::exchange(other.open, false);
+    }
+    return *this;
+}
+
+void MappedFile::discardBefore(const char* p) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t bytes = (size_t)(p - ptr) / page * page;
+    if (open && bytes > 0) madvise(const_cast<char*>(ptr), bytes, MADV_DONTNEED);
+}
+
+void MappedFile::release() {
+    if (open && len > 0) munmap(const_cast<char*>(ptr), len);
+    ptr = nullptr;
+    len = 0;
+    open = false;
+}
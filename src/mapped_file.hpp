@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return open; }
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+    const char* begin() const { return ptr; }
+    const char* end() const { return ptr + len; }
+    // drops the whole pages before p from memory; reading them again faults them back in
+    void discardBefore(const char* p);
+
+private:
+    void release();
+
+    const char* ptr = nullptr;
+    size_t len = 0;
+    bool open = false;
+};
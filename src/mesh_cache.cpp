@@ -0,0 +1,276 @@
+#include "mesh_cache.hpp"
+#include "mapped_file.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+    constexpr char MAGIC[4] = {'V', 'X', 'C', '1'};
+    constexpr uint32_t VERSION = 5;
+
+    // file layout: header, dependencies as { uint32 path length, path bytes, uint64 size,
+    // int64 mtime }, float[3] vertices, indices, float[3] face normals, Meshlet records,
+    // materials as { uint32 name length, name bytes, float kd[3] }, then lods as
+    // { LodHeader, indices, float[3] face normals, Meshlet records }. indices are three per
+    // face, uint16 when IndexBuffer::fitsNarrow(vertex_count) and uint32 otherwise
+    struct CacheHeader {
+        char magic[4];
+        uint32_t version;
+        uint64_t source_size;
+        int64_t source_mtime;
+        uint32_t flags;
+        uint32_t vertex_count;
+        uint32_t face_count;
+        uint32_t material_count;
+        uint32_t meshlet_count;
+        uint32_t lod_count;
+        uint32_t dependency_count;
+    };
+
+    struct LodHeader {
+        uint32_t face_count;
+        uint32_t meshlet_count;
+        float error;
+    };
+
+    static_assert(sizeof(Vec3) == 12, "Vec3 must be tightly packed");
+    static_assert(sizeof(Meshlet) == 44, "Meshlet must be tightly packed");
+
+    // size and mtime of a file; a missing file gets a size no real file has, so creating or
+    // deleting a dependency also invalidates the cache
+    void fileStamp(const std::string& path, uint64_t& size, int64_t& mtime) {
+        std::error_code ec;
+        size = fs::file_size(path, ec);
+        if (ec) size = UINT64_MAX;
+        mtime = fs::last_write_time(path, ec).time_since_epoch().count();
+        if (ec) mtime = 0;
+    }
+
+    bool readCacheFile(const std::string& path, const CacheKey& key, Model& m) {
+        MappedFile file(path);
+        if (!file.isOpen() || file.size() < sizeof(CacheHeader)) return false;
+
+        CacheHeader h;
+        std::memcpy(&h, file.data(), sizeof(h));
+        if (std::memcmp(h.magic, MAGIC, 4) != 0 || h.version != VERSION) return false;
+        if (h.source_size != key.size || h.source_mtime != key.mtime || h.flags != key.flags) return false;
+
+        size_t index_size = IndexBuffer::fitsNarrow(h.vertex_count) ? 2 : 4;
+        size_t vbytes = (size_t)h.vertex_count * sizeof(Vec3);
+        size_t fbytes = (size_t)h.face_count * 3 * index_size;
+        size_t nbytes = (size_t)h.face_count * sizeof(Vec3);
+        size_t mbytes = (size_t)h.meshlet_count * sizeof(Meshlet);
+        if (file.size() < sizeof(h) + vbytes + fbytes + nbytes + mbytes) return false;
+
+        // material libraries edited since the cache was written make it stale
+        const char* p = file.data() + sizeof(h);
+        m.dependencies.clear();
+        for (uint32_t i = 0; i < h.dependency_count; ++i) {
+            uint32_t len;
+            if (file.end() - p < 4) return false;
+            std::memcpy(&len, p, 4);
+            p += 4;
+            if ((size_t)(file.end() - p) < (size_t)len + 16) return false;
+
+            std::string dep(p, len);
+            uint64_t size, now_size;
+            int64_t mtime, now_mtime;
+            std::memcpy(&size, p + len, 8);
+            std::memcpy(&mtime, p + len + 8, 8);
+            p += len + 16;
+            fileStamp(dep, now_size, now_mtime);
+            if (size != now_size || mtime != now_mtime) return false;
+            m.dependencies.push_back(std::move(dep));
+        }
+        if ((size_t)(file.end() - p) < vbytes + fbytes + nbytes + mbytes) return false;
+
+        m.vertices.resize(h.vertex_count);
+        std::memcpy(m.vertices.data(), p, vbytes);
+        p += vbytes;
+        m.indices.resize(h.face_count, h.vertex_count);
+        std::memcpy(m.indices.bytes(), p, fbytes);
+        p += fbytes;
+        m.face_normals.resize(h.face_count);
+        std::memcpy(m.face_normals.data(), p, nbytes);
+        p += nbytes;
+        m.meshlets.resize(h.meshlet_count);
+        std::memcpy(m.meshlets.data(), p, mbytes);
+        p += mbytes;
+
+        m.materials.clear();
+        for (uint32_t i = 0; i < h.material_count; ++i) {
+            uint32_t len;
+            if (file.end() - p < 4) return false;
+            std::memcpy(&len, p, 4);
+            p += 4;
+            if ((size_t)(file.end() - p) < len + sizeof(Material::kd)) return false;
+
+            Material mat;
+            mat.name.assign(p, len);
+            p += len;
+            std::memcpy(mat.kd, p, sizeof(mat.kd));
+            p += sizeof(mat.kd);
+            m.materials.push_back(std::move(mat));
+        }
+
+        m.lods.resize(h.lod_count);
+        for (auto& lod : m.lods) {
+            LodHeader lh;
+            if ((size_t)(file.end() - p) < sizeof(lh)) return false;
+            std::memcpy(&lh, p, sizeof(lh));
+            p += sizeof(lh);
+
+            size_t lfbytes = (size_t)lh.face_count * 3 * index_size;
+            size_t lnbytes = (size_t)lh.face_count * sizeof(Vec3);
+            size_t lmbytes = (size_t)lh.meshlet_count * sizeof(Meshlet);
+            if ((size_t)(file.end() - p) < lfbytes + lnbytes + lmbytes) return false;
+
+            lod.error = lh.error;
+            lod.indices.resize(lh.face_count, h.vertex_count);
+            std::memcpy(lod.indices.bytes(), p, lfbytes);
+            p += lfbytes;
+            lod.face_normals.resize(lh.face_count);
+            std::memcpy(lod.face_normals.data(), p, lnbytes);
+            p += lnbytes;
+            lod.meshlets.resize(lh.meshlet_count);
+            std::memcpy(lod.meshlets.data(), p, lmbytes);
+            p += lmbytes;
+        }
+
+        // reject caches whose indices do not fit the vertex array
+        auto valid = [&](const IndexBuffer& indices, const std::vector<Meshlet>& meshlets) {
+            for (size_t i = 0; i < indices.faceCount() * 3; ++i) {
+                if (indices[i] >= h.vertex_count) return false;
+            }
+            for (const auto& ml : meshlets) {
+                if ((uint64_t)ml.first_face + ml.face_count > indices.faceCount()) return false;
+                if (ml.material < -1 || ml.material >= (int)h.material_count) return false;
+            }
+            return true;
+        };
+        if (!valid(m.indices, m.meshlets)) return false;
+        for (const auto& lod : m.lods) {
+            if (!valid(lod.indices, lod.meshlets)) return false;
+        }
+        return true;
+    }
+
+    bool writeCacheFile(const std::string& path, const CacheKey& key, const Model& m) {
+        std::error_code ec;
+        fs::create_directories(fs::path(path).parent_path(), ec);
+
+        // write to a temporary name so readers never see a partial cache; the pid keeps two
+        // processes converting the same model from writing into one file
+        std::string tmp = path + "." + std::to_string(getpid()) + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) return false;
+
+            // zeroed padding and all, so one model always gives the same bytes
+            CacheHeader h;
+            std::memset(&h, 0, sizeof(h));
+            std::memcpy(h.magic, MAGIC, 4);
+            h.version = VERSION;
+            h.source_size = key.size;
+            h.source_mtime = key.mtime;
+            h.flags = key.flags;
+            h.vertex_count = m.vertices.size();
+            h.face_count = m.indices.faceCount();
+            h.material_count = m.materials.size();
+            h.meshlet_count = m.meshlets.size();
+            h.lod_count = m.lods.size();
+            h.dependency_count = m.dependencies.size();
+
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            for (const auto& name : m.dependencies) {
+                // absolute, so the cache stays valid when the model is opened from elsewhere
+                std::string dep = fs::absolute(name, ec).string();
+                uint32_t len = dep.size();
+                uint64_t size;
+                int64_t mtime;
+                fileStamp(dep, size, mtime);
+                out.write(reinterpret_cast<const char*>(&len), 4);
+                out.write(dep.data(), len);
+                out.write(reinterpret_cast<const char*>(&size), 8);
+                out.write(reinterpret_cast<const char*>(&mtime), 8);
+            }
+            out.write(reinterpret_cast<const char*>(m.vertices.data()), m.vertices.size() * sizeof(Vec3));
+            out.write(m.indices.bytes(), m.indices.byteSize());
+            out.write(reinterpret_cast<const char*>(m.face_normals.data()), m.face_normals.size() * sizeof(Vec3));
+            out.write(reinterpret_cast<const char*>(m.meshlets.data()), m.meshlets.size() * sizeof(Meshlet));
+            for (const auto& mat : m.materials) {
+                uint32_t len = mat.name.size();
+                out.write(reinterpret_cast<const char*>(&len), 4);
+                out.write(mat.name.data(), len);
+                out.write(reinterpret_cast<const char*>(mat.kd), sizeof(mat.kd));
+            }
+            for (const auto& lod : m.lods) {
+                LodHeader lh{(uint32_t)lod.indices.faceCount(), (uint32_t)lod.meshlets.size(), lod.error};
+                out.write(reinterpret_cast<const char*>(&lh), sizeof(lh));
+                out.write(lod.indices.bytes(), lod.indices.byteSize());
+                out.write(reinterpret_cast<const char*>(lod.face_normals.data()), lod.face_normals.size() * sizeof(Vec3));
+                out.write(reinterpret_cast<const char*>(lod.meshlets.data()), lod.meshlets.size() * sizeof(Meshlet));
+            }
+            if (!out.good()) {
+                out.close();
+                fs::remove(tmp, ec);
+                return false;
+            }
+        }
+
+        fs::rename(tmp, path, ec);
+        if (ec) fs::remove(tmp, ec);
+        return !ec;
+    }
+}
+
+bool makeCacheKey(const std::string& source, uint32_t flags, CacheKey& key) {
+    std::error_code ec;
+    fs::path abs = fs::absolute(source, ec);
+    if (ec) return false;
+
+    key.size = fs::file_size(abs, ec);
+    if (ec) return false;
+    key.mtime = fs::last_write_time(abs, ec).time_since_epoch().count();
+    if (ec) return false;
+
+    key.source = abs.string();
+    key.flags = flags;
+    return true;
+}
+
+std::string siblingCachePath(const CacheKey& key) {
+    return key.source + ".vxc";
+}
+
+std::string userCachePath(const CacheKey& key) {
+    fs::path dir;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) dir = xdg;
+    else if (const char* home = std::getenv("HOME"); home && *home) dir = fs::path(home) / ".cache";
+    else dir = fs::temp_directory_path();
+
+    std::stringstream name;
+    name << std::hex << std::hash<std::string>{}(key.source) << "-" << fs::path(key.source).filename().string() << ".vxc";
+    return (dir / "voxcii" / name.str()).string();
+}
+
+bool readMeshCache(const CacheKey& key, Model& m) {
+    return readCacheFile(siblingCachePath(key), key, m) || 
+           readCacheFile(userCachePath(key), key, m);
+}
+
+bool writeMeshCache(const CacheKey& key, const Model& m, std::string* written) {
+    for (const auto& path : {siblingCachePath(key), userCachePath(key)}) {
+        if (writeCacheFile(path, key, m)) {
+            if (written) *written = path;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "model.hpp"
+#include <cstdint>
+#include <string>
+
+// identifies the source model a .vxc cache was built from
+struct CacheKey {
+    std::string source;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint32_t flags = 0;
+};
+
+bool makeCacheKey(const std::string& source, uint32_t flags, CacheKey& key);
+
+// cache next to the source model, falling back to the user cache directory
+std::string siblingCachePath(const CacheKey& key);
+std::string userCachePath(const CacheKey& key);
+
+bool readMeshCache(const CacheKey& key, Model& m);
+bool writeMeshCache(const CacheKey& key, const Model& m, std::string* written = nullptr);
@@ -1,93 +1,199 @@
 #include "model.hpp"
-#include <fstream>
-#include <sstream>
+#include "mapped_file.hpp"
+#include "mesh_cache.hpp"
+#include "thread_pool.hpp"
+#include "profiler.hpp"
+#include "obj_parse.hpp"
 #include <iostream>
 #include <limits>
 #include <cstring>
 #include <cmath>
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <algorithm>
 
 namespace {
-    float triArea(const Vec3& p1, const Vec3& p2, const Vec3& p3) {
-        return std::abs(p1.x*(p2.y - p3.y) + p2.x*(p3.y - p1.y) + p3.x*(p1.y - p2.y)) / 2.0f;
+    // obj text parsing
+
+    constexpr size_t OBJ_MIN_CHUNK = 1 << 20;
+
+    // meshlets
+
+    constexpr size_t MESHLET_SIZE = 64;
+
+    // 6 cube faces x 3x3 cells, so faces in one bin span at most ~45 degrees
+    uint32_t normalBin(const Vec3& n) {
+        float ax = std::abs(n.x), ay = std::abs(n.y), az = std::abs(n.z);
+        float m = std::max({ax, ay, az});
+        if (m == 0) return 0;
+
+        uint32_t face;
+        float u, v;
+        if (m == ax) { face = n.x > 0 ? 0 : 1; u = n.y / m; v = n.z / m; }
+        else if (m == ay) { face = n.y > 0 ? 2 : 3; u = n.x / m; v = n.z / m; }
+        else { face = n.z > 0 ? 4 : 5; u = n.x / m; v = n.y / m; }
+
+        uint32_t iu = std::min((uint32_t)((u + 1.0f) * 1.5f), 2u);
+        uint32_t iv = std::min((uint32_t)((v + 1.0f) * 1.5f), 2u);
+        return face * 9 + iv * 3 + iu;
     }
 
-    bool pointInTriangle(const Vec3& pt, const Vec3& v1, const Vec3& v2, const Vec3& v3) {
-        float total = triArea(v1, v2, v3);
-        float a1 = triArea(v1, v2, pt);
-        float a2 = triArea(v2, v3, pt);
-        float a3 = triArea(v3, v1, pt);
-        return (a1 + a2 + a3) <= total * 1.00001f;
+    // spreads the low 10 bits of x so two zero bits separate each
+    uint32_t expandBits(uint32_t x) {
+        x &= 0x3FF;
+        x = (x | (x << 16)) & 0x030000FF;
+        x = (x | (x << 8)) & 0x0300F00F;
+        x = (x | (x << 4)) & 0x030C30C3;
+        x = (x | (x << 2)) & 0x09249249;
+        return x;
     }
 
-    void triangularizeRecurse(std::vector<Vec3>& vecs, std::vector<int>& idxs, bool orient, std::vector<int>& out) {
-        size_t n = vecs.size();
-        if (n < 3) return;
-        if (n == 3) {
-            out.insert(out.end(), {idxs[0], idxs[1], idxs[2]});
-            return;
+    // vertex cache ordering
+
+    // Forsyth's scoring: a simulated LRU cache of CACHE_SIZE vertices, the last triangle's
+    // vertices scored flat, and a boost for vertices with few triangles left
+    constexpr int CACHE_SIZE = 32;
+    constexpr float LAST_TRI_SCORE = 0.75f;
+    constexpr float CACHE_DECAY = 1.5f;
+    constexpr float VALENCE_BOOST = 2.0f;
+    constexpr int MAX_VALENCE = 64;
+
+    struct CacheScores {
+        float cache[CACHE_SIZE];
+        float valence[MAX_VALENCE + 1];
+
+        CacheScores() {
+            for (int i = 0; i < CACHE_SIZE; ++i) {
+                cache[i] = i < 3 ? LAST_TRI_SCORE : std::pow(1.0f - (i - 3) / (float)(CACHE_SIZE - 3), CACHE_DECAY);
+            }
+            valence[0] = 0;
+            for (int i = 1; i <= MAX_VALENCE; ++i) valence[i] = VALENCE_BOOST / std::sqrt((float)i);
         }
 
-        int i1 = 0, i2 = 1, i3 = 2;
-        for (size_t t = 0; t < n; ++t) {
-            i1 = (n/2 + t + n - 1) % n;
-            i2 = (n/2 + t) % n;
-            i3 = (n/2 + t + 1) % n;
-
-            Vec3 d1 = vecs[i3] - vecs[i2];
-            Vec3 d2 = vecs[i1] - vecs[i2];
-            float cp = d1.cross(d2).z;
-            bool convex = (cp == 0) || ((cp > 0) != orient);
-            if (convex) break;
+        // position -1 is not cached; a vertex without remaining triangles scores nothing
+        float operator()(int position, int remaining) const {
+            if (remaining == 0) return -1.0f;
+            return (position >= 0 ? cache[position] : 0.0f) + valence[std::min(remaining, MAX_VALENCE)];
         }
+    };
+
+    // reorders faces [first, first + count) (one meshlet, so a quadratic pick is cheap) to
+    // reuse recently used vertices, moving their normals along
+    struct CacheOrder {
+        std::vector<int> verts;     // distinct vertices of the range
+        std::vector<int> corners;   // per face corner, index into verts
+        std::vector<int> remaining;
+        std::vector<float> score;
+        std::vector<uint8_t> done;
+        std::vector<int> cache, next_cache;
+        std::vector<uint32_t> order;
+        std::vector<Face> faces;
+        std::vector<Vec3> normals;
+
+        void run(std::vector<Face>& all_faces, std::vector<Vec3>& all_normals, size_t first, size_t count) {
+            static const CacheScores scores;
 
-        Vec3 v1 = vecs[i1], v2 = vecs[i2], v3 = vecs[i3];
-        // ear clipping check
-        float a = v1.y - v3.y;
-        float b = v3.x - v1.x;
-        float c = (v1.x - v3.x)*v1.y + (v3.y - v1.y)*v1.x;
-
-        int max_k = -1;
-        float max_dist = 0;
-
-        for (size_t k = 0; k < n; ++k) {
-            if (k == (size_t)i1 || k == (size_t)i2 || k == (size_t)i3) continue;
-            if (pointInTriangle(vecs[k], v1, v2, v3)) {
-                float dist = std::abs(a*vecs[k].x + b*vecs[k].y + c);
-                if (max_k == -1 || dist > max_dist) {
-                    max_dist = dist;
-                    max_k = k;
+            verts.clear();
+            for (size_t f = first; f < first + count; ++f) {
+                verts.insert(verts.end(), all_faces[f].idxs.begin(), all_faces[f].idxs.end());
+            }
+            std::sort(verts.begin(), verts.end());
+            verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+
+            corners.resize(count * 3);
+            remaining.assign(verts.size(), 0);
+            for (size_t f = 0; f < count; ++f) {
+                for (int k = 0; k < 3; ++k) {
+                    int v = std::lower_bound(verts.begin(), verts.end(), all_faces[first + f].idxs[k]) - verts.begin();
+                    corners[f * 3 + k] = v;
+                    ++remaining[v];
                 }
             }
-        }
+            score.resize(verts.size());
+            for (size_t v = 0; v < verts.size(); ++v) score[v] = scores(-1, remaining[v]);
+            done.assign(count, 0);
+            cache.clear();
+            order.clear();
+
+            for (size_t step = 0; step < count; ++step) {
+                size_t best = 0;
+                float best_score = -1e30f;
+                for (size_t f = 0; f < count; ++f) {
+                    if (done[f]) continue;
+                    float s = score[corners[f * 3]] + score[corners[f * 3 + 1]] + score[corners[f * 3 + 2]];
+                    if (s > best_score) {
+                        best_score = s;
+                        best = f;
+                    }
+                }
+                done[best] = 1;
+                order.push_back(best);
 
-        if (max_k == -1) {
-            out.insert(out.end(), {idxs[i1], idxs[i2], idxs[i3]});
-            vecs.erase(vecs.begin() + i2);
-            idxs.erase(idxs.begin() + i2);
-            triangularizeRecurse(vecs, idxs, orient, out);
-
-        } else {
-            // split polygon
-            std::vector<Vec3> vA, vB;
-            std::vector<int> iA, iB;
-            bool side = false;
-            for(size_t r = 0; r < n; ++r) {
-                if (r == (size_t)i2 || r == (size_t)max_k) {
-                    vA.push_back(vecs[r]); iA.push_back(idxs[r]);
-                    vB.push_back(vecs[r]); iB.push_back(idxs[r]);
-                    side = !side;
-                } else if (side) {
-                    vA.push_back(vecs[r]); iA.push_back(idxs[r]);
-                } else {
-                    vB.push_back(vecs[r]); iB.push_back(idxs[r]);
+                // the face's vertices move to the front of the cache
+                next_cache.clear();
+                for (int k = 0; k < 3; ++k) {
+                    int v = corners[best * 3 + k];
+                    --remaining[v];
+                    next_cache.push_back(v);
+                }
+                for (int v : cache) {
+                    if (v != next_cache[0] && v != next_cache[1] && v != next_cache[2]) next_cache.push_back(v);
+                }
+                if (next_cache.size() > CACHE_SIZE) {
+                    for (size_t i = CACHE_SIZE; i < next_cache.size(); ++i) score[next_cache[i]] = scores(-1, remaining[next_cache[i]]);
+                    next_cache.resize(CACHE_SIZE);
                 }
+                for (size_t i = 0; i < next_cache.size(); ++i) score[next_cache[i]] = scores(i, remaining[next_cache[i]]);
+                std::swap(cache, next_cache);
+            }
+
+            faces.assign(all_faces.begin() + first, all_faces.begin() + first + count);
+            normals.assign(all_normals.begin() + first, all_normals.begin() + first + count);
+            for (size_t i = 0; i < count; ++i) {
+                all_faces[first + i] = faces[order[i]];
+                all_normals[first + i] = normals[order[i]];
             }
-            triangularizeRecurse(vA, iA, orient, out);
-            triangularizeRecurse(vB, iB, orient, out);
         }
+    };
+}
+
+// index buffer
+
+void IndexBuffer::clear() {
+    wide = false;
+    idx16.clear();
+    idx32.clear();
+}
+
+void IndexBuffer::append(const std::vector<Face>& faces, size_t vertex_count) {
+    if (!wide && !fitsNarrow(vertex_count)) {
+        wide = true;
+        idx32.assign(idx16.begin(), idx16.end());
+        std::vector<uint16_t>().swap(idx16);
+    }
+    if (wide) {
+        idx32.reserve(idx32.size() + faces.size() * 3);
+        for (const Face& f : faces) idx32.insert(idx32.end(), f.idxs.begin(), f.idxs.end());
+    } else {
+        idx16.reserve(idx16.size() + faces.size() * 3);
+        for (const Face& f : faces) idx16.insert(idx16.end(), f.idxs.begin(), f.idxs.end());
     }
 }
 
+void IndexBuffer::remap(const std::vector<uint32_t>& map) {
+    for (uint16_t& i : idx16) i = map[i];
+    for (uint32_t& i : idx32) i = map[i];
+}
+
+void IndexBuffer::resize(size_t face_count, size_t vertex_count) {
+    clear();
+    wide = !fitsNarrow(vertex_count);
+    if (wide) idx32.resize(face_count * 3);
+    else idx16.resize(face_count * 3);
+}
+
 // model methods
 
 int Model::getMaterialIdx(const std::string& name) const {
@@ -97,152 +203,134 @@ int Model::getMaterialIdx(const std::string& name) const {
     return -1;
 }
 
-Model Model::loadFromObj(const std::string& filename, bool use_colors) {
+Model Model::loadFromObj(const std::string& filename, bool use_colors, int threads) {
     Model m;
-    std::ifstream file(filename);
-    if (!file.is_open()) {
+    MappedFile file(filename);
+    if (!file.isOpen()) {
         std::cerr << "ERROR: Failed to open " << filename << "\n";
         return m;
     }
 
-    std::string line, token;
-    int current_mat = -1;
-
-    while (std::getline(file, line)) {
-        if (line.empty() || line[0] == '#') continue;
-        std::stringstream ss(line);
-        ss >> token;
-
-        if (token == "v") {
-            float x, y, z;
-            ss >> x >> y >> z;
-            m.vertices.emplace_back(x, y, z);
-
-        } else if (token == "f") {
-            std::vector<int> f_idxs;
-            std::string segment;
-            while (ss >> segment) {
-                size_t slash = segment.find('/');
-                int idx = std::stoi(segment.substr(0, slash));
-                if (idx < 0) idx += m.vertices.size();
-                else idx -= 1;
-                f_idxs.push_back(idx);
-            }
+    // split into newline-aligned chunks
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t n_chunks = std::clamp<size_t>(file.size() / OBJ_MIN_CHUNK, 1, threads);
 
-            if (f_idxs.size() == 3) {
-                m.faces.push_back({
-                    {
-                        (int)f_idxs[0], 
-                        (int)f_idxs[1], 
-                        (int)f_idxs[2]
-                    }, 
-                    current_mat
-                });
-
-            } else if (f_idxs.size() > 3) {
-                // prep for triangularization
-                std::vector<Vec3> poly_vecs;
-                std::vector<int> poly_idxs = f_idxs;
-                
-                // calculate face normal to project to 2D
-                Vec3 d1 = m.vertices[f_idxs[1]] - m.vertices[f_idxs[0]];
-                Vec3 d2 = m.vertices[f_idxs[2]] - m.vertices[f_idxs[1]];
-                Vec3 norm = d1.cross(d2).normalize();
-                Vec3 perp = norm.cross(d1).normalize();
-                Vec3 dir1 = d1.normalize();
-                
-                for(int idx : f_idxs) {
-                    Vec3 v = m.vertices[idx];
-                    poly_vecs.emplace_back(dir1.dot(v), perp.dot(v), 0);
-                }
+    std::vector<const char*> bounds(n_chunks + 1);
+    bounds[0] = file.begin();
+    bounds[n_chunks] = file.end();
+    for (size_t i = 1; i < n_chunks; ++i) {
+        const char* p = std::max(file.begin() + file.size() * i / n_chunks, bounds[i - 1]);
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', file.end() - p));
+        bounds[i] = nl ? nl + 1 : file.end();
+    }
 
-                // determine orientation
-                float area = 0;
-                for (size_t i = 0; i < poly_vecs.size(); ++i) {
-                    Vec3 v1 = poly_vecs[i];
-                    Vec3 v2 = poly_vecs[(i + 1) % poly_vecs.size()];
-                    area += (v2.x - v1.x) * (v2.y + v1.y);
-                }
-                
-                std::vector<int> tri_indices;
-                triangularizeRecurse(poly_vecs, poly_idxs, area >= 0, tri_indices);
-                
-                for(size_t i=0; i < tri_indices.size(); i+=3) {
-                    m.faces.push_back({
-                        {
-                            tri_indices[i], 
-                            tri_indices[i+1], 
-                            tri_indices[i+2]
-                        }, 
-                        current_mat
-                    });
-                }
-            }
+    std::vector<ObjChunk> chunks(n_chunks);
+    ThreadPool pool(n_chunks);
+    {
+        ProfileScope scope("obj parse");
+        pool.run(n_chunks, [&](int, int i) {
+            parseObjChunk(bounds[i], bounds[i + 1], use_colors, chunks[i]);
+        });
+    }
 
-        } else if (use_colors && token == "mtllib") {
-            std::string mtl_file;
-            ss >> mtl_file;
-            
-            // manual path joining
-            std::string mtl_path;
-            size_t last_slash_idx = filename.rfind('/');
-            if (std::string::npos == last_slash_idx) {
-                last_slash_idx = filename.rfind('\\');
-            }
-            if (std::string::npos != last_slash_idx) {
-                mtl_path = filename.substr(0, last_slash_idx + 1) + mtl_file;
-            } else {
-                mtl_path = mtl_file;
+    // merge vertices
+    size_t total = 0;
+    for (auto& c : chunks) {
+        c.vertex_offset = total;
+        total += c.vertices.size();
+    }
+    m.vertices.reserve(total);
+    for (auto& c : chunks) {
+        m.vertices.insert(m.vertices.end(), c.vertices.begin(), c.vertices.end());
+        std::vector<Vec3>().swap(c.vertices);
+    }
+
+    // materials
+    std::unordered_map<std::string_view, int> mat_lookup;
+    if (use_colors) {
+        for (auto& c : chunks) {
+            for (auto lib : c.mtllibs) {
+                m.dependencies.push_back(siblingPath(filename, std::string(lib)));
+                loadMtl(m.dependencies.back(), m.materials);
             }
-            
-            std::ifstream mtl(mtl_path);
-            if (mtl.is_open()) {
-                std::string mline, mtok;
-                while(std::getline(mtl, mline)) {
-                    std::stringstream mss(mline);
-                    mss >> mtok;
-                    if(mtok == "newmtl") {
-                        std::string name; mss >> name;
-                        m.materials.push_back({name});
-                    } else if (mtok == "Kd" && !m.materials.empty()) {
-                        mss >> m.materials.back().kd[0] >> m.materials.back().kd[1] >> m.materials.back().kd[2];
-                    }
-                }
+        }
+        for (size_t i = 0; i < m.materials.size(); ++i) mat_lookup.emplace(m.materials[i].name, (int)i);
+    }
+
+    auto findMat = [&](std::string_view name) {
+        auto it = mat_lookup.find(name);
+        return it == mat_lookup.end() ? -1 : it->second;
+    };
+
+    // material still active at the start of each chunk
+    int active = -1;
+    for (auto& c : chunks) {
+        c.first_mat = active;
+        if (!c.usemtl.empty()) active = findMat(c.usemtl.back());
+    }
+
+    // resolve (possibly relative) indices and triangulate
+    ProfileScope resolve_scope("obj resolve");
+    pool.run(n_chunks, [&](int, int i) {
+        ObjChunk& c = chunks[i];
+        std::vector<int> slot_mats;
+        for (auto name : c.usemtl) slot_mats.push_back(findMat(name));
+
+        PolyScratch scratch;
+        std::vector<int> resolved;
+        c.out.reserve(c.faces.size());
+
+        for (const auto& f : c.faces) {
+            int64_t seen = c.vertex_offset + f.vertices_before;
+            resolved.clear();
+            for (uint32_t k = 0; k < f.count; ++k) {
+                int idx = c.idxs[f.first + k];
+                int64_t g = (idx < 0) ? seen + idx : (int64_t)idx - 1;
+                if (g < 0 || g >= (int64_t)total) break;
+                resolved.push_back((int)g);
             }
+            if (resolved.size() != f.count) continue;
 
-        } else if (use_colors && token == "usemtl") {
-            std::string mat_name;
-            ss >> mat_name;
-            current_mat = m.getMaterialIdx(mat_name);
+            int mat = (f.mat_slot < 0) ? c.first_mat : slot_mats[f.mat_slot];
+            triangulateFace(m.vertices, resolved, mat, scratch, c.out);
         }
-    }
+        std::vector<int>().swap(c.idxs);
+    });
+
+    // merge faces
+    size_t face_count = 0;
+    for (auto& c : chunks) face_count += c.out.size();
+    m.faces.reserve(face_count);
+    for (auto& c : chunks) m.faces.insert(m.faces.end(), c.out.begin(), c.out.end());
+
     return m;
 }
 
 Model Model::loadFromStl(const std::string& filename) {
     Model m;
-    std::ifstream file(filename, std::ios::binary);
-    if (!file.is_open()) return m;
+    MappedFile file(filename);
+    if (!file.isOpen() || file.size() < 84) return m;
 
-    char header[80];
-    file.read(header, 80);
-    std::string headerStr(header, 5);
-    
-    if (headerStr == "solid") {
+    uint32_t count;
+    std::memcpy(&count, file.data() + 80, 4);
+    bool binary = (84 + (uint64_t)count * 50 == file.size()) || std::strncmp(file.data(), "solid", 5) != 0;
+
+    if (!binary) {
         // ASCII STL
-        file.close(); 
-        file.open(filename);
-        std::string line, token;
-        while(std::getline(file, line)) {
-            std::stringstream ss(line);
-            ss >> token;
-            if (token == "vertex") {
-                float x, y, z;
-                ss >> x >> y >> z;
+        const char* p = file.begin();
+        while (p < file.end()) {
+            const char* eol = lineEnd(p, file.end());
+            if (nextToken(p, eol) == "vertex") {
+                float x = nextFloat(p, eol);
+                float y = nextFloat(p, eol);
+                float z = nextFloat(p, eol);
                 m.vertices.emplace_back(x, z, y);
             }
+            p = (eol < file.end()) ? eol + 1 : file.end();
         }
-        
+        m.vertices.resize(m.vertices.size() / 3 * 3);
+
+        m.faces.reserve(m.vertices.size() / 3);
         for(size_t i = 0; i < m.vertices.size(); i += 3) {
             m.faces.push_back({
                 {
@@ -255,35 +343,74 @@ Model Model::loadFromStl(const std::string& filename) {
         }
 
     } else {
-        // binary STL
-        uint32_t count;
-        file.read(reinterpret_cast<char*>(&count), 4);
+        // binary STL: 50 byte records of normal(3) + 3 verts(9) floats + 2 bytes attribute
+        count = std::min<uint64_t>(count, (file.size() - 84) / 50);
+        m.vertices.resize((size_t)count * 3);
+        m.faces.resize(count);
 
-        for(uint32_t i=0; i<count; ++i) {
-            float buffer[12]; // normal(3) + 3 verts(9)
-            file.read(reinterpret_cast<char*>(buffer), 50); // 12 floats + 2 bytes spacer
+        const char* rec = file.data() + 84;
+        for(uint32_t i = 0; i < count; ++i, rec += 50) {
+            float buffer[12];
+            std::memcpy(buffer, rec, sizeof(buffer));
 
-            for(int v=0; v<3; ++v) {
-                m.vertices.emplace_back(buffer[3 + v*3], buffer[5 + v*3], buffer[4 + v*3]); // swap Y/Z
+            for(int v = 0; v < 3; ++v) {
+                m.vertices[i*3 + v] = {buffer[3 + v*3], buffer[5 + v*3], buffer[4 + v*3]}; // swap Y/Z
             }
-            m.faces.push_back({
-                {
-                    (int)m.vertices.size()-3, 
-                    (int)m.vertices.size()-1, 
-                    (int)m.vertices.size()-2
-                },
-                -1
-            });
+            m.faces[i] = {{(int)i*3, (int)i*3 + 2, (int)i*3 + 1}, -1};
         }
     }
     return m;
 }
 
+Model Model::load(const std::string& filename, const LoadOptions& opts) {
+    ProfileScope scope("load");
+
+    CacheKey key;
+    bool cached = opts.cache && makeCacheKey(filename, opts.cacheFlags(), key);
+    if (cached) {
+        ProfileScope read_scope("cache read");
+        Model m;
+        if (readMeshCache(key, m)) return m;
+    }
+
+    Model m;
+    if (filename.find(".obj") != std::string::npos) {
+        m = loadFromObj(filename, opts.colors);
+        m.invertTriangles(); // fix winding order
+        m.transform(0, 1, 2, false, false, true); // invert z for obj standard
+    } else {
+        ProfileScope stl_scope("stl parse");
+        m = loadFromStl(filename);
+    }
+    if (m.vertices.empty()) return m;
+
+    if (opts.weld) {
+        ProfileScope weld_scope("weld");
+        m.weld(1e-6f);
+    }
+    m.normalize();
+    m.buildMeshlets();
+    {
+        ProfileScope lod_scope("lods");
+        m.buildLods();
+    }
+    m.optimize();
+
+    if (cached && opts.write_cache) {
+        ProfileScope write_scope("cache write");
+        writeMeshCache(key, m);
+    }
+    return m;
+}
+
 void Model::normalize() {
     if (vertices.empty()) return;
     
-    Vec3 minV = vertices[0], maxV = vertices[0];
+    // a stray NaN/inf vertex must not decide the fit of the rest of the model
+    constexpr float FMAX = std::numeric_limits<float>::max();
+    Vec3 minV = {FMAX, FMAX, FMAX}, maxV = minV * -1.0f;
     for (auto& v : vertices) {
+        if (!v.isFinite()) continue;
         minV.x = std::min(minV.x, v.x);
         minV.y = std::min(minV.y, v.y);
         minV.z = std::min(minV.z, v.z);
@@ -293,16 +420,17 @@ void Model::normalize() {
         maxV.z = std::max(maxV.z, v.z);
     }
     
+    if (minV.x > maxV.x) return;
     Vec3 center = (minV + maxV) * 0.5f;
-    float max_dist = 0;
+    double max_dist = 0;  // in double: the float magnitude can overflow for huge coordinates
     
     for(auto& v : vertices) {
         v = v - center;
-        float d = v.mag();
-        if(d > max_dist) max_dist = d;
+        double d = std::sqrt((double)v.x * v.x + (double)v.y * v.y + (double)v.z * v.z);
+        if(v.isFinite() && d > max_dist) max_dist = d;
     }
     
-    float scale = (max_dist == 0) ? 1.0f : 1.0f / max_dist;
+    float scale = (max_dist == 0) ? 1.0f : (float)(1.0 / max_dist);
     for(auto& v : vertices) v = v * scale;
 }
 
@@ -317,4 +445,205 @@ void Model::transform(int axis1, int axis2, int axis3, bool invX, bool invY, boo
         v.y = old[axis2] * (invY ? -1 : 1);
         v.z = old[axis3] * (invZ ? -1 : 1);
     }
-}
\ No newline at end of file
+}
+
+void Model::weld(float tolerance) {
+    if (vertices.empty()) return;
+
+    // bounds over finite vertices only; NaN/inf ones are kept as they are, never merged
+    constexpr float FMAX = std::numeric_limits<float>::max();
+    Vec3 minV = {FMAX, FMAX, FMAX}, maxV = minV * -1.0f;
+    for (auto& v : vertices) {
+        if (!v.isFinite()) continue;
+        minV = {std::min(minV.x, v.x), std::min(minV.y, v.y), std::min(minV.z, v.z)};
+        maxV = {std::max(maxV.x, v.x), std::max(maxV.y, v.y), std::max(maxV.z, v.z)};
+    }
+    if (minV.x > maxV.x) return;
+    // in double: the float extent can overflow for huge coordinates
+    double dx = (double)maxV.x - minV.x, dy = (double)maxV.y - minV.y, dz = (double)maxV.z - minV.z;
+    double diag = std::sqrt(dx * dx + dy * dy + dz * dz);
+    float eps = (float)std::clamp(tolerance * diag, (double)std::numeric_limits<float>::min(), (double)FMAX);
+    float inv_cell = 1.0f / eps;
+
+    // cells past +-2^40 only arise from extreme extents over a tiny eps; clamping keeps the
+    // float -> int conversion defined, and the exact distance test still decides merges
+    auto cellOf = [&](float d) {
+        return (int64_t)std::floor(std::clamp(d * inv_cell, -1099511627776.0f, 1099511627776.0f));
+    };
+
+    auto cellKey = [](int64_t x, int64_t y, int64_t z) {
+        return (uint64_t)(x & 0x1FFFFF) | ((uint64_t)(y & 0x1FFFFF) << 21) | ((uint64_t)(z & 0x1FFFFF) << 42);
+    };
+
+    // spatial hash of kept vertices, chained through next[]
+    std::unordered_map<uint64_t, int> heads;
+    heads.reserve(vertices.size());
+    std::vector<int> next;
+    std::vector<Vec3> kept;
+    std::vector<int> remap(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        const Vec3& v = vertices[i];
+        if (!v.isFinite()) {
+            remap[i] = kept.size();
+            kept.push_back(v);
+            next.push_back(-1);
+            continue;
+        }
+        int64_t cx = cellOf(v.x - minV.x);
+        int64_t cy = cellOf(v.y - minV.y);
+        int64_t cz = cellOf(v.z - minV.z);
+
+        int found = -1;
+        for (int ox = -1; ox <= 1 && found < 0; ++ox) {
+            for (int oy = -1; oy <= 1 && found < 0; ++oy) {
+                for (int oz = -1; oz <= 1 && found < 0; ++oz) {
+                    auto it = heads.find(cellKey(cx + ox, cy + oy, cz + oz));
+                    if (it == heads.end()) continue;
+                    for (int k = it->second; k >= 0; k = next[k]) {
+                        if ((kept[k] - v).mag() <= eps) {
+                            found = k;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (found < 0) {
+            found = kept.size();
+            kept.push_back(v);
+            auto [it, inserted] = heads.try_emplace(cellKey(cx, cy, cz), found);
+            next.push_back(inserted ? -1 : it->second);
+            it->second = found;
+        }
+        remap[i] = found;
+    }
+
+    // remap faces, dropping the ones that collapsed
+    size_t out = 0;
+    for (auto& f : faces) {
+        Face nf = {{remap[f.idxs[0]], remap[f.idxs[1]], remap[f.idxs[2]]}, f.material_idx};
+        if (nf.idxs[0] == nf.idxs[1] || nf.idxs[1] == nf.idxs[2] || nf.idxs[0] == nf.idxs[2]) continue;
+        faces[out++] = nf;
+    }
+    faces.resize(out);
+    kept.shrink_to_fit();
+    vertices = std::move(kept);
+}
+
+void Model::buildMeshlets() {
+    buildMeshlets(vertices, faces, face_normals, meshlets);
+}
+
+void Model::buildMeshlets(const std::vector<Vec3>& vertices, std::vector<Face>& faces,
+                          std::vector<Vec3>& face_normals, std::vector<Meshlet>& meshlets) {
+    size_t n = faces.size();
+    face_normals.resize(n);
+    meshlets.clear();
+    if (n == 0) return;
+
+    std::vector<Vec3> centroids(n);
+    Vec3 minC{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    Vec3 maxC = minC * -1.0f;
+    for (size_t i = 0; i < n; ++i) {
+        const Vec3& a = vertices[faces[i].idxs[0]];
+        const Vec3& b = vertices[faces[i].idxs[1]];
+        const Vec3& c = vertices[faces[i].idxs[2]];
+        face_normals[i] = (b - a).cross(c - a).normalize();
+        centroids[i] = (a + b + c) * (1.0f / 3.0f);
+        minC = {std::min(minC.x, centroids[i].x), std::min(minC.y, centroids[i].y), std::min(minC.z, centroids[i].z)};
+        maxC = {std::max(maxC.x, centroids[i].x), std::max(maxC.y, centroids[i].y), std::max(maxC.z, centroids[i].z)};
+    }
+
+    // sort by material, then normal bin (tight cones), then morton order of the centroid
+    // (spatial locality)
+    Vec3 ext = maxC - minC;
+    auto quant = [](float v, float lo, float e) {
+        return e > 0 ? (uint32_t)std::min((v - lo) / e * 1023.0f, 1023.0f) : 0u;
+    };
+    std::vector<std::pair<uint64_t, uint32_t>> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        const Vec3& c = centroids[i];
+        uint32_t morton = expandBits(quant(c.x, minC.x, ext.x)) |
+                          (expandBits(quant(c.y, minC.y, ext.y)) << 1) |
+                          (expandBits(quant(c.z, minC.z, ext.z)) << 2);
+        uint64_t material = (uint64_t)(faces[i].material_idx + 1) << 38;
+        keys[i] = {material | ((uint64_t)normalBin(face_normals[i]) << 32) | morton, (uint32_t)i};
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<Face> sorted_faces(n);
+    std::vector<Vec3> sorted_normals(n);
+    for (size_t i = 0; i < n; ++i) {
+        sorted_faces[i] = faces[keys[i].second];
+        sorted_normals[i] = face_normals[keys[i].second];
+    }
+    faces = std::move(sorted_faces);
+    face_normals = std::move(sorted_normals);
+
+    // cut runs of up to MESHLET_SIZE faces that share material and normal bin
+    CacheOrder cache_order;
+    for (size_t i = 0; i < n;) {
+        size_t j = i + 1;
+        while (j < n && j - i < MESHLET_SIZE && (keys[j].first >> 32) == (keys[i].first >> 32)) ++j;
+
+        Meshlet ml;
+        ml.first_face = i;
+        ml.face_count = j - i;
+        ml.material = faces[i].material_idx;
+        cache_order.run(faces, face_normals, i, j - i);
+
+        // bounding sphere around the bounding box
+        Vec3 lo = vertices[faces[i].idxs[0]], hi = lo;
+        Vec3 axis;
+        for (size_t f = i; f < j; ++f) {
+            for (int idx : faces[f].idxs) {
+                const Vec3& v = vertices[idx];
+                lo = {std::min(lo.x, v.x), std::min(lo.y, v.y), std::min(lo.z, v.z)};
+                hi = {std::max(hi.x, v.x), std::max(hi.y, v.y), std::max(hi.z, v.z)};
+            }
+            axis = axis + face_normals[f];
+        }
+        ml.center = (lo + hi) * 0.5f;
+        ml.radius = 0;
+        for (size_t f = i; f < j; ++f) {
+            for (int idx : faces[f].idxs) ml.radius = std::max(ml.radius, (vertices[idx] - ml.center).mag());
+        }
+
+        // normal cone: cutoff = sin(half angle), never culled once the cone reaches 90 degrees
+        ml.cone_axis = axis.normalize();
+        float min_cos = 1.0f;
+        for (size_t f = i; f < j; ++f) min_cos = std::min(min_cos, face_normals[f].dot(ml.cone_axis));
+        bool degenerate = ml.cone_axis.mag() == 0 || min_cos <= 0;
+        ml.cone_cutoff = degenerate ? 2.0f : std::sqrt(std::max(0.0f, 1.0f - min_cos * min_cos));
+
+        meshlets.push_back(ml);
+        i = j;
+    }
+}
+
+void Model::optimize() {
+    // first use in meshlet order, so each meshlet gathers from a short stretch of vertices
+    constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(vertices.size(), UNUSED);
+    uint32_t next = 0;
+    for (Face& f : faces) {
+        for (int& idx : f.idxs) {
+            if (remap[idx] == UNUSED) remap[idx] = next++;
+            idx = remap[idx];
+        }
+    }
+    for (uint32_t& r : remap) {
+        if (r == UNUSED) r = next++;
+    }
+
+    std::vector<Vec3> ordered(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) ordered[remap[i]] = vertices[i];
+    vertices = std::move(ordered);
+    for (Lod& lod : lods) lod.indices.remap(remap);
+
+    indices.clear();
+    indices.append(faces, vertices.size());
+    std::vector<Face>().swap(faces);
+}
@@ -3,28 +3,116 @@
 #include <vector>
 #include <string>
 #include <array>
+#include <cstdint>
 
+// triangle as loaded and processed; optimize() turns them into an IndexBuffer
 struct Face {
     std::array<int, 3> idxs;
     int material_idx{-1};
 };
 
+// three vertex indices per triangle, 16-bit while every vertex index fits
+class IndexBuffer {
+public:
+    static bool fitsNarrow(size_t vertex_count) { return vertex_count <= 65536; }
+
+    size_t faceCount() const { return (wide ? idx32.size() : idx16.size()) / 3; }
+    bool isWide() const { return wide; }
+    const uint16_t* narrow() const { return idx16.data(); }
+    const uint32_t* wideData() const { return idx32.data(); }
+    uint32_t operator[](size_t i) const { return wide ? idx32[i] : idx16[i]; }
+
+    void clear();
+    // appends faces indexing [0, vertex_count); widens every index once vertex_count needs it
+    void append(const std::vector<Face>& faces, size_t vertex_count);
+    // new index of vertex i is map[i]; the vertex count is unchanged
+    void remap(const std::vector<uint32_t>& map);
+
+    // raw storage, sized for face_count faces over vertex_count vertices (mesh cache)
+    void resize(size_t face_count, size_t vertex_count);
+    char* bytes() { return wide ? reinterpret_cast<char*>(idx32.data()) : reinterpret_cast<char*>(idx16.data()); }
+    const char* bytes() const { return wide ? reinterpret_cast<const char*>(idx32.data()) : reinterpret_cast<const char*>(idx16.data()); }
+    size_t byteSize() const { return wide ? idx32.size() * 4 : idx16.size() * 2; }
+
+private:
+    bool wide = false;
+    std::vector<uint16_t> idx16;
+    std::vector<uint32_t> idx32;
+};
+
 struct Material {
     std::string name;
     float kd[3]{1.0f, 1.0f, 1.0f};
 };
 
+// cluster of consecutive faces of one material with a bounding sphere and a normal cone
+struct Meshlet {
+    uint32_t first_face, face_count;
+    Vec3 center;
+    float radius;
+    Vec3 cone_axis;
+    // every face is back-facing when dot(cone_axis, view_dir) <= -cone_cutoff
+    float cone_cutoff;
+    int32_t material;  // -1 for none
+};
+
+// simplified copy of the mesh sharing the full-resolution vertex array
+struct Lod {
+    IndexBuffer indices;
+    std::vector<Vec3> face_normals;
+    std::vector<Meshlet> meshlets;
+    float error = 0;  // accumulated quadric error distance, in model units
+};
+
+struct LoadOptions {
+    bool colors = false;
+    bool weld = false;
+    bool cache = true;        // read .vxc mesh caches
+    bool write_cache = true;  // and write them when missing or stale
+
+    // options that change the loaded geometry, stored in the cache key
+    uint32_t cacheFlags() const { return (colors ? 1u : 0u) | (weld ? 2u : 0u); }
+};
+
 class Model {
 public:
     std::vector<Vec3> vertices;
+    // triangles while loading; optimize() moves them into indices
     std::vector<Face> faces;
+    IndexBuffer indices;
     std::vector<Material> materials;
+    // other files the model was built from (material libraries), checked by the mesh cache
+    std::vector<std::string> dependencies;
+
+    // derived by buildMeshlets(); faces are grouped by material and reordered so each meshlet
+    // is a contiguous range, its faces in vertex-cache order
+    std::vector<Vec3> face_normals;
+    std::vector<Meshlet> meshlets;
+    // coarser with every index; level 0 (the members above) is not included
+    std::vector<Lod> lods;
 
-    static Model loadFromObj(const std::string& filename, bool use_colors);
+    // threads <= 0 uses every core for large files
+    static Model loadFromObj(const std::string& filename, bool use_colors, int threads = 0);
     static Model loadFromStl(const std::string& filename);
+    // full pipeline (parse, triangulate, weld, normalize, meshlets, lods, optimize), served from
+    // the .vxc cache when fresh
+    static Model load(const std::string& filename, const LoadOptions& opts);
 
     void normalize();
     void invertTriangles();
     void transform(int axis1, int axis2, int axis3, bool invX, bool invY, bool invZ);
+    // merge vertices closer than tolerance * bounding box diagonal
+    void weld(float tolerance);
     int getMaterialIdx(const std::string& name) const;
+    // computes unit face normals and groups faces into meshlets; call once geometry is final
+    void buildMeshlets();
+    static void buildMeshlets(const std::vector<Vec3>& vertices, std::vector<Face>& faces,
+                              std::vector<Vec3>& face_normals, std::vector<Meshlet>& meshlets);
+    // builds the lods chain by quadric-error edge collapse, keeping material borders intact
+    void buildLods();
+    static std::vector<Lod> buildLods(const std::vector<Vec3>& vertices, const std::vector<Face>& faces);
+    // renumbers vertices in the order the meshlets first use them and moves faces into the
+    // compact indices of level 0; call after buildLods
+    void optimize();
+    size_t levelFaceCount(int level) const { return level == 0 ? indices.faceCount() : lods[level - 1].indices.faceCount(); }
 };
\ No newline at end of file
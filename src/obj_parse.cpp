@@ -0,0 +1,145 @@
+#include "obj_parse.hpp"
+#include "mapped_file.hpp"
+#include <charconv>
+#include <cstring>
+
+namespace {
+    bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    const char* skipSpace(const char* p, const char* end) {
+        while (p < end && isSpace(*p)) ++p;
+        return p;
+    }
+}
+
+std::string_view nextToken(const char*& p, const char* end) {
+    p = skipSpace(p, end);
+    const char* start = p;
+    while (p < end && !isSpace(*p)) ++p;
+    return {start, (size_t)(p - start)};
+}
+
+float nextFloat(const char*& p, const char* end) {
+    p = skipSpace(p, end);
+    if (p < end && *p == '+') ++p;
+    float v = 0;
+    auto res = std::from_chars(p, end, v);
+    if (res.ec == std::errc()) p = res.ptr;
+    return v;
+}
+
+const char* lineEnd(const char* p, const char* end) {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return nl ? nl : end;
+}
+
+std::string siblingPath(const std::string& filename, const std::string& name) {
+    // manual path joining
+    size_t last_slash_idx = filename.rfind('/');
+    if (std::string::npos == last_slash_idx) {
+        last_slash_idx = filename.rfind('\\');
+    }
+    if (std::string::npos != last_slash_idx) {
+        return filename.substr(0, last_slash_idx + 1) + name;
+    }
+    return name;
+}
+
+void parseObjChunk(const char* p, const char* end, bool use_colors, ObjChunk& c) {
+    int slot = -1;
+    while (p < end) {
+        const char* eol = lineEnd(p, end);
+        std::string_view tok = nextToken(p, eol);
+
+        if (tok == "v") {
+            float x = nextFloat(p, eol);
+            float y = nextFloat(p, eol);
+            float z = nextFloat(p, eol);
+            c.vertices.emplace_back(x, y, z);
+
+        } else if (tok == "f") {
+            uint32_t first = c.idxs.size();
+            while ((p = skipSpace(p, eol)) < eol) {
+                int idx;
+                auto res = std::from_chars(p, eol, idx);
+                if (res.ec != std::errc()) break;
+                c.idxs.push_back(idx);
+                // skip texture/normal indices
+                p = res.ptr;
+                while (p < eol && !isSpace(*p)) ++p;
+            }
+
+            uint32_t count = c.idxs.size() - first;
+            if (count >= 3) c.faces.push_back({first, count, (uint32_t)c.vertices.size(), slot});
+            else c.idxs.resize(first);
+
+        } else if (use_colors && tok == "mtllib") {
+            c.mtllibs.push_back(nextToken(p, eol));
+
+        } else if (use_colors && tok == "usemtl") {
+            slot = c.usemtl.size();
+            c.usemtl.push_back(nextToken(p, eol));
+        }
+
+        p = (eol < end) ? eol + 1 : end;
+    }
+}
+
+void loadMtl(const std::string& path, std::vector<Material>& materials) {
+    MappedFile mtl(path);
+    if (!mtl.isOpen()) return;
+
+    const char* p = mtl.begin();
+    while (p < mtl.end()) {
+        const char* eol = lineEnd(p, mtl.end());
+        std::string_view tok = nextToken(p, eol);
+
+        if (tok == "newmtl") {
+            materials.push_back({std::string(nextToken(p, eol))});
+        } else if (tok == "Kd" && !materials.empty()) {
+            for (float& k : materials.back().kd) k = nextFloat(p, eol);
+        }
+
+        p = (eol < mtl.end()) ? eol + 1 : mtl.end();
+    }
+}
+
+void triangulateFace(const std::vector<Vec3>& verts, const std::vector<int>& f_idxs, int mat, PolyScratch& s, std::vector<Face>& out) {
+    size_t n = f_idxs.size();
+    if (n == 3) {
+        out.push_back({{f_idxs[0], f_idxs[1], f_idxs[2]}, mat});
+        return;
+    }
+
+    // newell normal, robust to collinear leading vertices
+    Vec3 norm(0, 0, 0);
+    for (size_t i = 0, j = n - 1; i < n; j = i++) {
+        const Vec3& a = verts[f_idxs[j]];
+        const Vec3& b = verts[f_idxs[i]];
+        norm.x += (a.y - b.y) * (a.z + b.z);
+        norm.y += (a.z - b.z) * (a.x + b.x);
+        norm.z += (a.x - b.x) * (a.y + b.y);
+    }
+
+    s.tris.clear();
+    if (norm.mag() == 0) {
+        // degenerate polygon: any fan is as good as another
+        for (size_t i = 1; i + 1 < n; ++i) s.tris.insert(s.tris.end(), {0, (int)i, (int)i + 1});
+    } else {
+        // project onto the face plane
+        norm = norm.normalize();
+        Vec3 axis = std::abs(norm.x) < 0.5f ? Vec3(1, 0, 0) : Vec3(0, 1, 0);
+        Vec3 u = norm.cross(axis).normalize();
+        Vec3 v = norm.cross(u);
+
+        s.vecs.clear();
+        for (int idx : f_idxs) s.vecs.emplace_back(u.dot(verts[idx]), v.dot(verts[idx]), 0);
+        s.triangulator.triangulate(s.vecs, s.tris);
+    }
+
+    for (size_t i = 0; i < s.tris.size(); i += 3) {
+        out.push_back({{f_idxs[s.tris[i]], f_idxs[s.tris[i+1]], f_idxs[s.tris[i+2]]}, mat});
+    }
+}
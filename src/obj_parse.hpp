@@ -0,0 +1,47 @@
+#pragma once
+#include "model.hpp"
+#include "triangulate.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// obj text parsing shared by the batch and streaming loaders
+
+const char* lineEnd(const char* p, const char* end);
+std::string_view nextToken(const char*& p, const char* end);
+float nextFloat(const char*& p, const char* end);
+// name resolved next to filename
+std::string siblingPath(const std::string& filename, const std::string& name);
+
+struct ObjFace {
+    uint32_t first, count;     // range in ObjChunk::idxs
+    uint32_t vertices_before;  // chunk-local vertex count when the face was read
+    int mat_slot;              // index into ObjChunk::usemtl, -1 = inherited from previous chunk
+};
+
+struct ObjChunk {
+    std::vector<Vec3> vertices;
+    std::vector<int> idxs;
+    std::vector<ObjFace> faces;
+    std::vector<std::string_view> usemtl;
+    std::vector<std::string_view> mtllibs;
+
+    size_t vertex_offset = 0;
+    int first_mat = -1;
+    std::vector<Face> out;
+};
+
+// collects the v/f/mtllib/usemtl lines of [p, end); indices are kept unresolved
+void parseObjChunk(const char* p, const char* end, bool use_colors, ObjChunk& c);
+void loadMtl(const std::string& path, std::vector<Material>& materials);
+
+// polygon buffers reused across faces
+struct PolyScratch {
+    std::vector<Vec3> vecs;
+    std::vector<int> tris;
+    Triangulator triangulator;
+};
+
+// appends the triangles of polygon f_idxs (indices into verts) to out
+void triangulateFace(const std::vector<Vec3>& verts, const std::vector<int>& f_idxs, int mat, PolyScratch& s, std::vector<Face>& out);
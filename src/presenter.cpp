@@ -0,0 +1,225 @@
+#include "presenter.hpp"
+#include <ncurses.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+    // longest escape a cell can need: a 24-bit color and a cursor move, plus its glyph
+    constexpr size_t CELL_BYTES = 19 + 12 + 1;
+
+    char* append(char* p, const char* s) {
+        size_t n = std::strlen(s);
+        std::memcpy(p, s, n);
+        return p + n;
+    }
+
+    char* appendInt(char* p, int v) {
+        char digits[12];
+        int n = 0;
+        do {
+            digits[n++] = (char)('0' + v % 10);
+            v /= 10;
+        } while (v > 0);
+        while (n > 0) *p++ = digits[--n];
+        return p;
+    }
+}
+
+void NCursesPresenter::invalidate() {
+    std::fill(glyphs.begin(), glyphs.end(), '\0');
+}
+
+void NCursesPresenter::present(const Surface& surf, bool color_support) {
+    if (surf.getWidth() != width || surf.getHeight() != height) {
+        width = surf.getWidth();
+        height = surf.getHeight();
+        glyphs.assign(width * height, '\0');
+        colors.assign(width * height, 0);
+    }
+    if (color_support) presentCells<true>(surf);
+    else presentCells<false>(surf);
+}
+
+template <bool Color>
+void NCursesPresenter::presentCells(const Surface& surf) {
+    int attr = 0;
+    attrset(A_NORMAL);
+
+    for (int y = 0; y < height; ++y) {
+        const char* glyph = surf.glyphRow(y);
+        const int16_t* material = Color ? surf.materialRow(y) : nullptr;
+        char* prev_glyph = &glyphs[y * width];
+        int* prev_color = &colors[y * width];
+
+        auto colorOf = [&](int x) {
+            if constexpr (Color) return material[x] != -1 ? material[x] + 1 : 0;
+            else return 0;
+        };
+        auto changed = [&](int x) {
+            if constexpr (Color) return glyph[x] != prev_glyph[x] || colorOf(x) != prev_color[x];
+            else return glyph[x] != prev_glyph[x];
+        };
+
+        char line[512];
+        int x = 0;
+        while (x < width) {
+            if (!changed(x)) {
+                ++x;
+                continue;
+            }
+
+            // extend the run over cells of the same color, bridging short unchanged gaps
+            int color = colorOf(x);
+            int last = x;
+            for (int k = x + 1; k < width && k - x < (int)sizeof(line) && colorOf(k) == color; ++k) {
+                if (changed(k)) last = k;
+                else if (k - last > MAX_GAP) break;
+            }
+
+            int len = last - x + 1;
+            for (int k = 0; k < len; ++k) {
+                line[k] = glyph[x + k];
+                prev_glyph[x + k] = glyph[x + k];
+                if constexpr (Color) prev_color[x + k] = color;
+            }
+
+            if (color != attr) {
+                attrset(color ? COLOR_PAIR(color) : A_NORMAL);
+                attr = color;
+            }
+            mvaddnstr(y, x, line, len);
+            x = last + 1;
+        }
+    }
+
+    if (attr != 0) attrset(A_NORMAL);
+}
+
+void AnsiPresenter::invalidate() {
+    full = true;
+}
+
+bool AnsiPresenter::present(const Surface& surf, const std::vector<Material>* materials) {
+    if (surf.getWidth() != width || surf.getHeight() != height) {
+        width = surf.getWidth();
+        height = surf.getHeight();
+        glyphs.resize(width * height);
+        colors.resize(width * height);
+        buffer.resize((size_t)width * height * CELL_BYTES + 32);
+        full = true;
+    }
+
+    char* p = buffer.data();
+    if (full) {
+        // reset attributes and clear, then treat every cell as changed
+        p = append(p, "\x1b[0m\x1b[2J");
+        std::fill(glyphs.begin(), glyphs.end(), '\0');
+        std::fill(colors.begin(), colors.end(), DEFAULT_COLOR);
+        color = DEFAULT_COLOR;
+        cursor_x = cursor_y = -1;
+        full = false;
+    }
+
+    if (materials) {
+        palette.resize(materials->size());
+        for (size_t i = 0; i < materials->size(); ++i) palette[i] = materialColor((*materials)[i]);
+        p = encodeCells<true>(surf, p);
+    } else {
+        p = encodeCells<false>(surf, p);
+    }
+
+    sent = p - buffer.data();
+    const char* data = buffer.data();
+    size_t left = sent;
+    while (left > 0) {
+        ssize_t n = write(fd, data, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        left -= n;
+    }
+    return true;
+}
+
+template <bool Color>
+char* AnsiPresenter::encodeCells(const Surface& surf, char* p) {
+    for (int y = 0; y < height; ++y) {
+        const char* glyph = surf.glyphRow(y);
+        const int16_t* material = Color ? surf.materialRow(y) : nullptr;
+        char* prev_glyph = &glyphs[y * width];
+        int32_t* prev_color = &colors[y * width];
+
+        for (int x = 0; x < width; ++x) {
+            int32_t c = DEFAULT_COLOR;
+            if constexpr (Color) c = material[x] >= 0 ? palette[material[x]] : DEFAULT_COLOR;
+            if (glyph[x] == prev_glyph[x] && c == prev_color[x]) continue;
+
+            if (cursor_y != y || cursor_x > x) {
+                p = moveTo(p, x, y);
+            } else if (cursor_x < x) {
+                // a short unchanged gap in the current color is cheaper to rewrite than to skip
+                bool bridge = x - cursor_x <= MAX_GAP;
+                for (int k = cursor_x; bridge && k < x; ++k) bridge = prev_color[k] == color;
+                if (bridge) {
+                    std::memcpy(p, prev_glyph + cursor_x, x - cursor_x);
+                    p += x - cursor_x;
+                } else {
+                    p = moveTo(p, x, y);
+                }
+            }
+
+            if (c != color) p = setColor(p, c);
+            *p++ = glyph[x];
+            prev_glyph[x] = glyph[x];
+            prev_color[x] = c;
+            // after the last column the cursor waits to wrap, so its position is unknown
+            cursor_x = x + 1 < width ? x + 1 : -1;
+            cursor_y = x + 1 < width ? y : -1;
+        }
+    }
+    return p;
+}
+
+char* AnsiPresenter::moveTo(char* p, int x, int y) {
+    if (cursor_y == y && cursor_x >= 0 && x > cursor_x) {
+        // forward on the same row is shorter than an absolute position
+        p = append(p, "\x1b[");
+        p = appendInt(p, x - cursor_x);
+        *p++ = 'C';
+    } else {
+        p = append(p, "\x1b[");
+        p = appendInt(p, y + 1);
+        *p++ = ';';
+        p = appendInt(p, x + 1);
+        *p++ = 'H';
+    }
+    return p;
+}
+
+int32_t AnsiPresenter::materialColor(const Material& mat) {
+    int rgb[3];
+    // the float compare also sends NaN to 0, which the int cast would not
+    for (int k = 0; k < 3; ++k) rgb[k] = mat.kd[k] > 0 ? (int)std::min(mat.kd[k] * 255, 255.0f) : 0;
+    return rgb[0] << 16 | rgb[1] << 8 | rgb[2];
+}
+
+char* AnsiPresenter::colorEscape(char* p, int32_t rgb) {
+    if (rgb == DEFAULT_COLOR) return append(p, "\x1b[39m");
+    p = append(p, "\x1b[38;2;");
+    p = appendInt(p, rgb >> 16 & 0xff);
+    *p++ = ';';
+    p = appendInt(p, rgb >> 8 & 0xff);
+    *p++ = ';';
+    p = appendInt(p, rgb & 0xff);
+    *p++ = 'm';
+    return p;
+}
+
+char* AnsiPresenter::setColor(char* p, int32_t rgb) {
+    color = rgb;
+    return colorEscape(p, rgb);
+}
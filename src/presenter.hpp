@@ -0,0 +1,71 @@
+#pragma once
+#include "model.hpp"
+#include "surface.hpp"
+#include <string>
+#include <vector>
+
+// writes a Surface to the ncurses screen, touching only the cells that
+// changed since the previous frame
+class NCursesPresenter {
+public:
+    void present(const Surface& surf, bool color_support);
+    // forces a full redraw on the next present (e.g. after a resize)
+    void invalidate();
+
+private:
+    // color output fixed at compile time keeps the material plane out of the cell loop
+    template <bool Color>
+    void presentCells(const Surface& surf);
+
+    // unchanged cells shorter than this are rewritten rather than skipped with a cursor move
+    static constexpr int MAX_GAP = 4;
+
+    int width = 0, height = 0;
+    std::vector<char> glyphs;
+    std::vector<int> colors;
+};
+
+// writes a Surface straight to a terminal file descriptor as ANSI escapes with 24-bit
+// color, without ncurses' palette. each frame is encoded into one preallocated buffer and
+// sent with a single write(): only changed cells are sent, a cursor move skips unchanged
+// spans and a color escape is emitted only where the color changes
+class AnsiPresenter {
+public:
+    explicit AnsiPresenter(int fd) : fd(fd) {}
+
+    // materials give the colors, nullptr for monochrome; false when the write failed
+    bool present(const Surface& surf, const std::vector<Material>* materials);
+    // clears the screen and redraws every cell on the next present (e.g. after a resize)
+    void invalidate();
+    // bytes sent by the last present
+    size_t lastBytes() const { return sent; }
+
+    // the terminal's own foreground color
+    static constexpr int32_t DEFAULT_COLOR = -1;
+
+    // a material's diffuse color as 0xRRGGBB, each channel clamped to [0, 255]
+    static int32_t materialColor(const Material& mat);
+    // writes the foreground escape for rgb, or DEFAULT_COLOR, at p and returns its end;
+    // at most 19 bytes
+    static char* colorEscape(char* p, int32_t rgb);
+
+private:
+    template <bool Color>
+    char* encodeCells(const Surface& surf, char* p);
+    char* moveTo(char* p, int x, int y);
+    char* setColor(char* p, int32_t rgb);
+
+    // unchanged cells shorter than this are rewritten rather than skipped with a cursor move
+    static constexpr int MAX_GAP = 4;
+
+    int fd;
+    int width = 0, height = 0;
+    bool full = true;
+    std::vector<char> glyphs;
+    std::vector<int32_t> colors;   // 0xRRGGBB per cell as last sent
+    std::vector<int32_t> palette;  // 0xRRGGBB per material of the current frame
+    std::vector<char> buffer;      // sized for the worst case frame
+    int cursor_x = -1, cursor_y = -1;  // -1 when unknown
+    int32_t color = DEFAULT_COLOR;     // foreground the terminal is set to
+    size_t sent = 0;
+};
@@ -0,0 +1,139 @@
+#include "profiler.hpp"
+#include <cstdio>
+#include <cstring>
+
+Profiler& Profiler::get() {
+    static Profiler instance;
+    return instance;
+}
+
+void Profiler::startTrace(const std::string& path) {
+    trace_path = path;
+    tracing = true;
+}
+
+namespace {
+    // small per-thread ids for the trace, in order of first use
+    int threadId() {
+        static std::atomic<int> next{1};
+        thread_local int id = next++;
+        return id;
+    }
+
+    thread_local Profiler::Capture* capture = nullptr;
+}
+
+int64_t Profiler::micros(Clock::time_point t) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(t - origin).count();
+}
+
+Profiler::Stat& Profiler::stat(const char* name, bool counter) {
+    // a handful of distinct names, so a linear scan beats hashing
+    for (auto& s : stats) {
+        if (s.name == name || std::strcmp(s.name, name) == 0) {
+            s.last_seen = frame_index;
+            return s;
+        }
+    }
+    stats.push_back({name, 0, 0, counter, frame_index});
+    return stats.back();
+}
+
+void Profiler::record(const char* name, Clock::time_point begin, Clock::time_point end) {
+    if (capture) {
+        double ms = std::chrono::duration<double, std::milli>(end - begin).count();
+        capture->entries.push_back({name, ms, false, micros(begin), micros(end) - micros(begin), threadId()});
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    stat(name, false).frame += std::chrono::duration<double, std::milli>(end - begin).count();
+    if (tracing) events.push_back({name, micros(begin), micros(end) - micros(begin), 0, false, threadId()});
+}
+
+void Profiler::count(const char* name, double value) {
+    if (capture) {
+        capture->entries.push_back({name, value, true, micros(Clock::now()), 0, threadId()});
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    stat(name, true).frame += value;
+    if (tracing) events.push_back({name, micros(Clock::now()), 0, value, true, threadId()});
+}
+
+void Profiler::beginCapture(Capture* out) {
+    out->entries.clear();
+    capture = out;
+}
+
+void Profiler::endCapture() {
+    capture = nullptr;
+}
+
+void Profiler::add(const Capture& c) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const auto& e : c.entries) {
+        stat(e.name, e.counter).frame += e.value;
+        if (tracing) events.push_back({e.name, e.ts, e.dur, e.counter ? e.value : 0, e.counter, e.tid});
+    }
+}
+
+void Profiler::endFrame() {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto now = Clock::now();
+    double ms = std::chrono::duration<double, std::milli>(now - last_frame).count();
+    last_frame = now;
+
+    // exponential moving average keeps the HUD readable
+    const float k = 0.1f;
+    frame_ms += (ms - frame_ms) * k;
+    for (auto& s : stats) {
+        s.average += (s.frame - s.average) * k;
+        s.frame = 0;
+    }
+    ++frame_index;
+}
+
+std::vector<std::string> Profiler::hudLines() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<std::string> lines;
+    char buf[96];
+
+    std::snprintf(buf, sizeof(buf), " frame %7.2f ms  %5.1f fps ", frame_ms, frame_ms > 0 ? 1000.0 / frame_ms : 0.0);
+    lines.push_back(buf);
+    for (const auto& s : stats) {
+        // one-off scopes (e.g. loading) drop out after a second or so
+        if (frame_index - s.last_seen > 20) continue;
+        if (s.counter) std::snprintf(buf, sizeof(buf), " %-12s %10.0f ", s.name, s.average);
+        else std::snprintf(buf, sizeof(buf), " %-12s %7.3f ms ", s.name, s.average);
+        lines.push_back(buf);
+    }
+    return lines;
+}
+
+bool Profiler::finish() {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!tracing) return true;
+    tracing = false;
+
+    FILE* f = std::fopen(trace_path.c_str(), "w");
+    if (!f) return false;
+
+    std::fprintf(f, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < events.size(); ++i) {
+        const Event& e = events[i];
+        if (e.counter) {
+            std::fprintf(f, "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%lld,\"pid\":1,\"tid\":%d,\"args\":{\"value\":%.3f}}",
+                         e.name, (long long)e.ts, e.tid, e.value);
+        } else {
+            std::fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%d}",
+                         e.name, (long long)e.ts, (long long)e.dur, e.tid);
+        }
+        std::fprintf(f, i + 1 < events.size() ? ",\n" : "\n");
+    }
+    std::fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    bool ok = !std::ferror(f);
+    std::fclose(f);
+    events.clear();
+    return ok;
+}
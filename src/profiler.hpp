@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// per-stage timers and counters shared by the render and present threads. every
+// entry point is a single branch while profiling is off
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // what one thread recorded while capturing, held back until add() credits it to the
+    // frame being shown
+    struct Capture {
+        struct Entry {
+            const char* name;
+            double value;  // ms for scopes
+            bool counter;
+            int64_t ts, dur;  // trace times, microseconds since start
+            int tid;
+        };
+        std::vector<Entry> entries;
+    };
+
+    static Profiler& get();
+
+    bool active() const { return hud.load(std::memory_order_relaxed) || tracing.load(std::memory_order_relaxed); }
+    bool hudVisible() const { return hud.load(std::memory_order_relaxed); }
+    void setHud(bool visible) { hud = visible; }
+    // record every scope and counter, written as Chrome trace-event JSON by finish()
+    void startTrace(const std::string& path);
+
+    void record(const char* name, Clock::time_point begin, Clock::time_point end);
+    void count(const char* name, double value);
+    // while the calling thread captures, its scopes and counters go to out instead of the
+    // current frame, so work on frames that are never shown stays out of the HUD and trace
+    void beginCapture(Capture* out);
+    void endCapture();
+    void add(const Capture& capture);
+    // closes the current frame's HUD averages
+    void endFrame();
+    std::vector<std::string> hudLines() const;
+
+    bool finish();
+
+private:
+    struct Stat {
+        const char* name;
+        double frame = 0;    // accumulated this frame
+        double average = 0;  // smoothed across frames
+        bool counter = false;
+        int64_t last_seen = 0;  // frame index of the last update
+    };
+
+    struct Event {
+        const char* name;
+        int64_t ts, dur;  // microseconds since start
+        double value;
+        bool counter;
+        int tid;
+    };
+
+    Stat& stat(const char* name, bool counter);
+    int64_t micros(Clock::time_point t) const;
+
+    std::atomic<bool> hud{false};
+    std::atomic<bool> tracing{false};
+    mutable std::mutex mtx;
+    std::string trace_path;
+    Clock::time_point origin = Clock::now();
+    Clock::time_point last_frame = origin;
+    double frame_ms = 0;
+    int64_t frame_index = 0;
+
+    std::vector<Stat> stats;
+    std::vector<Event> events;
+};
+
+// times the enclosing block
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) : name(name), on(Profiler::get().active()) {
+        if (on) begin = Profiler::Clock::now();
+    }
+    ~ProfileScope() {
+        if (on) Profiler::get().record(name, begin, Profiler::Clock::now());
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    bool on;
+    Profiler::Clock::time_point begin;
+};
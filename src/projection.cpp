@@ -0,0 +1,102 @@
+#include "projection.hpp"
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 must be tightly packed");
+
+Projection Projection::view(float az, float al, float lw, float lh, float zoom) {
+    // rotateY(az) followed by rotateX(-al)
+    float cy = std::cos(az), sy = std::sin(az);
+    float cx = std::cos(-al), sx = std::sin(-al);
+    float k = 0.5f * zoom;
+
+    return {{
+        { k * cy,        0.0f,     -k * sy,       0.5f * lw },
+        { k * sx * sy,  -k * cx,    k * sx * cy,  0.5f * lh },
+        { k * cx * sy,   k * sx,    k * cx * cy,  0.5f      }
+    }};
+}
+
+Projection Projection::placement(const Vec3& offset, float scale, float yaw, float pitch, float roll) {
+    float cy = std::cos(yaw), sy = std::sin(yaw);
+    float cx = std::cos(pitch), sx = std::sin(pitch);
+    float cz = std::cos(roll), sz = std::sin(roll);
+
+    // Ry * Rx * Rz, columns scaled
+    return {{
+        { scale * (cy * cz + sy * sx * sz), scale * (sy * sx * cz - cy * sz), scale * sy * cx, offset.x },
+        { scale * cx * sz,                  scale * cx * cz,                  scale * -sx,     offset.y },
+        { scale * (cy * sx * sz - sy * cz), scale * (cy * sx * cz + sy * sz), scale * cy * cx, offset.z }
+    }};
+}
+
+Projection Projection::operator*(const Projection& inner) const {
+    Projection out;
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 4; ++c) {
+            out.m[r][c] = m[r][0] * inner.m[0][c] + m[r][1] * inner.m[1][c] + m[r][2] * inner.m[2][c];
+        }
+        out.m[r][3] += m[r][3];
+    }
+    return out;
+}
+
+Vec3 Projection::apply(const Vec3& v) const {
+    return {
+        m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z + m[0][3],
+        m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z + m[1][3],
+        m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z + m[2][3]
+    };
+}
+
+void ScreenVertices::resize(size_t n) {
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+}
+
+void projectVertices(const std::vector<Vec3>& in, const Projection& proj, ScreenVertices& out, size_t first) {
+    size_t n = in.size();
+    if (out.x.size() < first + n) out.resize(first + n);
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    const float* src = &in.data()->x;
+    __m128 m[3][4];
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 4; ++c) m[r][c] = _mm_set1_ps(proj.m[r][c]);
+    }
+    float* dst[3] = {out.x.data() + first, out.y.data() + first, out.z.data() + first};
+
+    for (; i + 4 <= n; i += 4) {
+        // 4 packed Vec3 = x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3, transpose to SoA
+        __m128 a = _mm_loadu_ps(src + 3*i);
+        __m128 b = _mm_loadu_ps(src + 3*i + 4);
+        __m128 c = _mm_loadu_ps(src + 3*i + 8);
+
+        __m128 vx = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3,3,0,0)),
+                                   _mm_shuffle_ps(b, c, _MM_SHUFFLE(1,1,2,2)), _MM_SHUFFLE(2,0,2,0));
+        __m128 vy = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0,0,1,1)),
+                                   _mm_shuffle_ps(b, c, _MM_SHUFFLE(2,2,3,3)), _MM_SHUFFLE(2,0,2,0));
+        __m128 vz = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1,1,2,2)),
+                                   _mm_shuffle_ps(c, c, _MM_SHUFFLE(3,3,0,0)), _MM_SHUFFLE(2,0,2,0));
+
+        for (int r = 0; r < 3; ++r) {
+            __m128 acc = _mm_add_ps(_mm_mul_ps(m[r][0], vx), m[r][3]);
+            acc = _mm_add_ps(acc, _mm_mul_ps(m[r][1], vy));
+            acc = _mm_add_ps(acc, _mm_mul_ps(m[r][2], vz));
+            _mm_storeu_ps(dst[r] + i, acc);
+        }
+    }
+#endif
+
+    for (; i < n; ++i) {
+        Vec3 v = proj.apply(in[i]);
+        out.x[first + i] = v.x;
+        out.y[first + i] = v.y;
+        out.z[first + i] = v.z;
+    }
+}
\ No newline at end of file
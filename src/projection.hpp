@@ -0,0 +1,27 @@
+#pragma once
+#include "vec3.hpp"
+#include <vector>
+
+// affine model -> surface mapping (rotation, zoom and screen offset folded together)
+struct Projection {
+    float m[3][4];
+
+    static Projection view(float az, float al, float lw, float lh, float zoom);
+    // uniform scale, then roll about z, pitch about x and yaw about y (radians), then offset
+    static Projection placement(const Vec3& offset, float scale, float yaw, float pitch, float roll);
+    // mapping that applies inner first and this one after it
+    Projection operator*(const Projection& inner) const;
+    Vec3 apply(const Vec3& v) const;
+    Vec3 row(int r) const { return {m[r][0], m[r][1], m[r][2]}; }
+};
+
+// projected vertices stored as structure-of-arrays, reused across frames
+struct ScreenVertices {
+    std::vector<float> x, y, z;
+
+    void resize(size_t n);
+    Vec3 operator[](size_t i) const { return {x[i], y[i], z[i]}; }
+};
+
+// writes in.size() vertices starting at out[first], growing out when needed
+void projectVertices(const std::vector<Vec3>& in, const Projection& proj, ScreenVertices& out, size_t first = 0);
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include "renderer.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // triangles per covered cell beyond which a coarser level looks the same
+    constexpr float MAX_DENSITY = 2.0f;
+
+    float luminance(const Vec3& norm, const Vec3& light) {
+        return std::clamp(norm.dot(light) * 0.5f + 0.5f, 0.0f, 1.0f);
+    }
+
+    char getLumChar(const Vec3& norm, const Vec3& light, const std::string& chars) {
+        float sim = luminance(norm, light);
+        size_t idx = std::clamp((size_t)std::round((chars.size() - 1) * sim), (size_t)0, chars.size() - 1);
+        return chars[idx];
+    }
+}
+
+View animatedView(float t, float zoom) {
+    // animation constants
+    const float PI = 3.14159265359f;
+    const float GOLDEN_RATIO = 1.6180339887f;
+    const float az_speed = 2.0f;
+    const float al_speed = GOLDEN_RATIO * 0.25f;
+
+    View v;
+    v.az = az_speed * t;
+    // oscillate altitude slightly for 3D effect
+    v.al = 0.125f * PI * (1.0f - std::sin(al_speed * t));
+    v.zoom = zoom;
+    return v;
+}
+
+Renderer::Renderer(const Config& cfg) 
+    : cfg(cfg), light(Vec3(1, -1, 0).normalize()), raster(cfg.threads) {
+    static constexpr RenderFn VARIANTS[] = {
+        &Renderer::renderVariant<0>,
+        &Renderer::renderVariant<COLOR>,
+        &Renderer::renderVariant<SAMPLES>,
+        &Renderer::renderVariant<SAMPLES | COLOR>,
+        &Renderer::renderVariant<PREPASS>,
+        &Renderer::renderVariant<PREPASS | COLOR>,
+        &Renderer::renderVariant<PREPASS | SAMPLES>,
+        &Renderer::renderVariant<PREPASS | SAMPLES | COLOR>,
+    };
+    unsigned v = (cfg.color ? COLOR : 0) | (cfg.ss_x * cfg.ss_y > 1 ? SAMPLES : 0) | (cfg.prepass ? PREPASS : 0);
+    variant = VARIANTS[v];
+}
+
+Surface Renderer::makeSurface(int w, int h, float scale) const {
+    // aspect ratio correction for characters
+    float logical_h = 1.0f;
+    float logical_w = (float)w / (h * 1.8f);
+
+    Surface surface(std::max(1, (int)std::lround(w * scale)), std::max(1, (int)std::lround(h * scale)),
+                    logical_w, logical_h);
+    surface.setRasterMode(cfg.raster);
+    return surface;
+}
+
+int Renderer::selectLod(const Model& model, const View& view, const Surface& surface, float radius) const {
+    int levels = (int)model.lods.size();
+    if (cfg.lod >= 0) return std::min(cfg.lod, levels);
+
+    // the screen footprint of the bounding sphere is at most an ellipse of radii
+    // 0.5 * zoom * radius in logical units, clipped to the surface
+    float w = surface.getWidth(), h = surface.getHeight();
+    float rx = 0.5f * view.zoom * radius * w / surface.getLogicalWidth();
+    float ry = 0.5f * view.zoom * radius * h / surface.getLogicalHeight();
+    float footprint = std::min(3.14159265f * rx * ry, w * h);
+
+    // about half the faces point away, so count front faces against the covered cells
+    int level = 0;
+    while (level < levels && model.levelFaceCount(level) * 0.5f > MAX_DENSITY * footprint) ++level;
+    return level;
+}
+
+Surface& Renderer::sampleSurface(const Surface& cells) {
+    int w = cells.getWidth() * cfg.ss_x, h = cells.getHeight() * cfg.ss_y;
+    if (!samples || samples->getWidth() != w || samples->getHeight() != h ||
+        samples->getLogicalWidth() != cells.getLogicalWidth()) {
+        samples = std::make_unique<Surface>(w, h, cells.getLogicalWidth(), cells.getLogicalHeight());
+        samples->setRasterMode(cfg.raster);
+    }
+    return *samples;
+}
+
+RasterStats Renderer::render(const Scene& scene, const View& view, Surface& cells) {
+    return (this->*variant)(scene, view, cells);
+}
+
+template <unsigned V>
+RasterStats Renderer::renderVariant(const Scene& scene, const View& view, Surface& cells) {
+    // raster variants of the depth prepass (if any) and of the shading pass
+    constexpr unsigned color = (V & COLOR) ? RASTER_COLOR : 0;
+    constexpr unsigned shade = (V & PREPASS) ? color | RASTER_DEPTH_EQUAL : color;
+
+    // supersampling rasterizes luminance bytes into a finer surface and resolves it into cells
+    constexpr bool supersampled = V & SAMPLES;
+    Surface& surface = supersampled ? sampleSurface(cells) : cells;
+    {
+        ProfileScope scope("clear");
+        surface.clear(supersampled ? '\0' : ' ', color);
+        raster.begin(surface);
+    }
+
+    float lw = surface.getLogicalWidth(), lh = surface.getLogicalHeight();
+    Projection proj = Projection::view(view.az, view.al, lw, lh, view.zoom);
+    // rows of proj are scaled by 0.5 * zoom
+    float k = 0.5f * view.zoom;
+
+    uint64_t culled_instances = 0;
+    size_t triangles = 0;
+    {
+        // transform + project every shared vertex once per visible instance; instances
+        // are grouped by mesh, so each mesh's vertices are streamed back to back
+        ProfileScope scope("vertex");
+        draws.clear();
+        uint32_t first_vertex = 0;
+        for (const Instance& inst : scene.instances) {
+            Vec3 c = proj.apply(inst.center);
+            float r = inst.radius * k;
+            if (c.x + r < 0 || c.x - r > lw || c.y + r < 0 || c.y - r > lh) {
+                ++culled_instances;
+                continue;
+            }
+
+            Draw d;
+            d.instance = &inst;
+            d.proj = proj * inst.transform;
+            d.first_vertex = first_vertex;
+            d.level = selectLod(scene.meshes[inst.mesh], view, surface, inst.radius);
+            d.radius_scale = inst.scale * k;
+
+            // view rotation rows (the screen mapping scales them and mirrors y); a face is
+            // visible when its normal points along view_dir
+            Vec3 right = d.proj.row(0).normalize();
+            Vec3 up = d.proj.row(1).normalize() * -1.0f;
+            d.view_dir = d.proj.row(2).normalize();
+            // light in model space, so each face is lit with its precomputed normal
+            d.light = right * light.x + up * light.y + d.view_dir * light.z;
+
+            const std::vector<Vec3>& vertices = scene.meshes[inst.mesh].vertices;
+            projectVertices(vertices, d.proj, screen, first_vertex);
+            first_vertex += vertices.size();
+            draws.push_back(d);
+        }
+    }
+
+    uint64_t culled = 0, culled_meshlets = 0, occluded = 0;
+    {
+        ProfileScope scope("setup+light");
+
+        // front-to-back meshlet order across all instances lets the hierarchical depth
+        // test reject hidden ones
+        order.clear();
+        for (uint32_t d = 0; d < draws.size(); ++d) {
+            const Draw& draw = draws[d];
+            const Model& mesh = scene.meshes[draw.instance->mesh];
+            const auto& meshlets = draw.level == 0 ? mesh.meshlets : mesh.lods[draw.level - 1].meshlets;
+            triangles += mesh.levelFaceCount(draw.level);
+
+            for (uint32_t i = 0; i < meshlets.size(); ++i) {
+                const Meshlet& ml = meshlets[i];
+                if (ml.cone_axis.dot(draw.view_dir) <= -ml.cone_cutoff) {
+                    culled += ml.face_count;
+                    ++culled_meshlets;
+                    continue;
+                }
+                order.push_back({draw.proj.apply(ml.center).z - ml.radius * draw.radius_scale, {d, i}});
+            }
+        }
+        std::sort(order.begin(), order.end());
+    }
+
+    RasterStats prepass;
+    if constexpr ((V & PREPASS) != 0) {
+        // final depth first, so shading writes each visible cell once and the hierarchical
+        // test sees the finished depth buffer
+        ProfileScope scope("prepass");
+        uint64_t prepass_culled = 0, prepass_occluded = 0;
+        submitMeshlets<V, RASTER_DEPTH_ONLY>(scene, surface, prepass_culled, prepass_occluded);
+        prepass = raster.flush<RASTER_DEPTH_ONLY>();
+        raster.begin(surface);
+    }
+    {
+        ProfileScope scope("setup+light");
+        submitMeshlets<V, shade>(scene, surface, culled, occluded);
+    }
+
+    RasterStats stats;
+    {
+        ProfileScope scope("raster");
+        stats = raster.flush<shade>();
+    }
+    stats.tested += prepass.tested;
+    stats.culled += culled;
+    stats.occluded += occluded;
+
+    if constexpr (supersampled) {
+        ProfileScope scope("supersample");
+        cells.resolve<color>(surface, cfg.ss_x, cfg.ss_y, cfg.chars);
+    }
+
+    Profiler& prof = Profiler::get();
+    if (prof.active()) {
+        size_t covered = surface.coveredCount();
+        prof.count("lod", draws.empty() ? 0 : draws[0].level);
+        prof.count("instances cut", culled_instances);
+        prof.count("triangles", triangles);
+        prof.count("culled", stats.culled);
+        prof.count("meshlets cut", culled_meshlets);
+        prof.count("occluded", stats.occluded);
+        prof.count("px tested", stats.tested);
+        prof.count("px written", stats.written);
+        prof.count("overdraw", covered ? (double)stats.written / covered : 0.0);
+    }
+    return stats;
+}
+
+template <unsigned V, unsigned F>
+void Renderer::submitMeshlets(const Scene& scene, Surface& surface, uint64_t& culled, uint64_t& occluded) {
+    for (const auto& [near_z, item] : order) {
+        const Draw& draw = draws[item.first];
+        const Model& mesh = scene.meshes[draw.instance->mesh];
+        const Lod* lod = draw.level == 0 ? nullptr : &mesh.lods[draw.level - 1];
+        const IndexBuffer& indices = lod ? lod->indices : mesh.indices;
+        const std::vector<Vec3>& face_normals = lod ? lod->face_normals : mesh.face_normals;
+        const Meshlet& ml = lod ? lod->meshlets[item.second] : mesh.meshlets[item.second];
+
+        // bounding sphere on screen
+        float r = ml.radius * draw.radius_scale;
+        Vec3 c = draw.proj.apply(ml.center);
+        Rect rect = surface.bounds(c - Vec3(r, r, 0), c + Vec3(r, r, 0));
+        if (!raster.beginGroup<F>(rect, near_z)) {
+            occluded += ml.face_count;
+            continue;
+        }
+
+        // one material per meshlet
+        int material = -1;
+        if constexpr ((F & RASTER_COLOR) != 0) {
+            if (ml.material >= 0) material = ml.material + scene.material_offsets[draw.instance->mesh];
+        }
+
+        // the index width is fixed per mesh, so each meshlet runs a loop for one width
+        auto submitFaces = [&](const auto* idx) {
+            uint32_t base = draw.first_vertex;
+            for (uint32_t f = ml.first_face; f < ml.first_face + ml.face_count; ++f) {
+                const Vec3& normal = face_normals[f];
+                if (normal.dot(draw.view_dir) <= 0) {
+                    ++culled;
+                    continue;
+                }
+
+                Triangle t = {screen[base + idx[f * 3]], screen[base + idx[f * 3 + 1]], screen[base + idx[f * 3 + 2]]};
+
+                // only what the variant stores is computed
+                char ch = 0;
+                if constexpr (!(F & RASTER_DEPTH_ONLY)) {
+                    if constexpr ((V & SAMPLES) != 0) ch = (char)(1 + std::lround(254 * luminance(normal * -1.0f, draw.light)));
+                    else ch = getLumChar(normal * -1.0f, draw.light, cfg.chars);
+                }
+                raster.submit<F>(t, ch, material);
+            }
+        };
+        if (indices.isWide()) submitFaces(indices.wideData());
+        else submitFaces(indices.narrow());
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "config.hpp"
+#include "model.hpp"
+#include "projection.hpp"
+#include "scene.hpp"
+#include "surface.hpp"
+#include "tile_raster.hpp"
+#include <memory>
+
+struct View {
+    float az = 0, al = 0;
+    float zoom = 1.0f;
+
+    bool operator!=(const View& o) const { return az != o.az || al != o.al || zoom != o.zoom; }
+};
+
+// auto-rotation schedule at t seconds
+View animatedView(float t, float zoom);
+
+// turns a Scene into shaded triangles on a Surface; owns the per-frame buffers
+class Renderer {
+public:
+    explicit Renderer(const Config& cfg);
+
+    // surface sized w x h cells with aspect ratio correction for characters; a scale below
+    // 1 keeps the logical size of w x h on proportionally fewer cells
+    Surface makeSurface(int w, int h, float scale = 1.0f) const;
+    RasterStats render(const Scene& scene, const View& view, Surface& cells);
+
+    // level of detail for the current footprint of a model whose bounding sphere has the
+    // given radius in scene units: 0 is full resolution, i is model.lods[i - 1]
+    int selectLod(const Model& model, const View& view, const Surface& surface, float radius = 1.0f) const;
+
+private:
+    // an instance that reaches the viewport this frame
+    struct Draw {
+        const Instance* instance;
+        Projection proj;        // view * instance transform
+        uint32_t first_vertex;  // of its projected vertices in screen
+        int level;
+        float radius_scale;     // model units -> logical surface units
+        Vec3 view_dir, light;   // in model space
+    };
+
+    // compile-time feature sets of render(), one picked at construction
+    enum Variant : unsigned {
+        COLOR = 1,    // material indices for color output
+        SAMPLES = 2,  // supersampled: luminance bytes resolved into cells
+        PREPASS = 4,  // depth-only pass before shading
+    };
+    using RenderFn = RasterStats (Renderer::*)(const Scene&, const View&, Surface&);
+
+    template <unsigned V>
+    RasterStats renderVariant(const Scene& scene, const View& view, Surface& cells);
+    // submits the front faces of the sorted meshlets as Surface raster variant F
+    template <unsigned V, unsigned F>
+    void submitMeshlets(const Scene& scene, Surface& surface, uint64_t& culled, uint64_t& occluded);
+    Surface& sampleSurface(const Surface& cells);
+
+    const Config& cfg;
+    RenderFn variant;
+    Vec3 light;
+    ScreenVertices screen;
+    std::vector<Draw> draws;
+    // (nearest depth, (draw, meshlet index)) of the meshlets that survive cone culling
+    std::vector<std::pair<float, std::pair<uint32_t, uint32_t>>> order;
+    TileRasterizer raster;
+    // cfg.ss_x x cfg.ss_y samples per cell when supersampling
+    std::unique_ptr<Surface> samples;
+};
@@ -0,0 +1,133 @@
+#include "scene.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+    constexpr float DEG = 3.14159265359f / 180.0f;
+}
+
+bool Scene::isDescription(const std::string& filename) {
+    return fs::path(filename).extension() == ".scene";
+}
+
+Scene Scene::load(const std::string& filename, const LoadOptions& opts) {
+    if (isDescription(filename)) return loadDescription(filename, opts);
+    return single(Model::load(filename, opts));
+}
+
+Scene Scene::single(Model model) {
+    Scene s;
+    if (model.vertices.empty()) return s;
+    s.meshes.push_back(std::move(model));
+    s.instances.push_back({0, Projection::placement({0, 0, 0}, 1.0f, 0, 0, 0), 1.0f, {0, 0, 0}, 1.0f});
+    s.finish();
+    return s;
+}
+
+// one instance per line: <model path> [x y z [scale [yaw [pitch [roll]]]]], angles in degrees.
+// paths are relative to the scene file, '#' starts a comment
+Scene Scene::loadDescription(const std::string& filename, const LoadOptions& opts) {
+    ProfileScope scope("scene");
+    Scene s;
+    std::ifstream in(filename);
+    if (!in) {
+        std::cerr << "ERROR: Failed to open " << filename << "\n";
+        return s;
+    }
+
+    fs::path dir = fs::path(filename).parent_path();
+    std::vector<std::string> mesh_files;
+    std::string line;
+    for (int line_no = 1; std::getline(in, line); ++line_no) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string file;
+        if (!(fields >> file)) continue;
+
+        float v[7] = {0, 0, 0, 1, 0, 0, 0};
+        int n = 0;
+        bool ok = true;
+        for (std::string field; ok && fields >> field; ++n) {
+            char* end;
+            if (n < 7) v[n] = std::strtof(field.c_str(), &end);
+            ok = n < 7 && *end == '\0';
+        }
+        if (!ok || (n > 0 && n < 3) || v[3] <= 0) {
+            std::cerr << "ERROR: " << filename << ":" << line_no << ": expected <model> [x y z [scale [yaw [pitch [roll]]]]]\n";
+            return {};
+        }
+
+        std::string path = (dir / file).string();
+        auto it = std::find(mesh_files.begin(), mesh_files.end(), path);
+        uint32_t mesh = it - mesh_files.begin();
+        if (it == mesh_files.end()) {
+            Model m = Model::load(path, opts);
+            if (m.vertices.empty()) {
+                std::cerr << "ERROR: No vertices loaded from " << path << "\n";
+                return {};
+            }
+            mesh_files.push_back(path);
+            s.meshes.push_back(std::move(m));
+        }
+
+        // meshes are normalized to the unit sphere around their origin
+        Vec3 pos(v[0], v[1], v[2]);
+        Projection t = Projection::placement(pos, v[3], v[4] * DEG, v[5] * DEG, v[6] * DEG);
+        s.instances.push_back({mesh, t, v[3], pos, v[3]});
+    }
+
+    s.finish();
+    return s;
+}
+
+void Scene::finish() {
+    // instances of one mesh are drawn back to back so its vertices stay in cache
+    std::stable_sort(instances.begin(), instances.end(),
+                     [](const Instance& a, const Instance& b) { return a.mesh < b.mesh; });
+
+    for (const Model& m : meshes) {
+        material_offsets.push_back(materials.size());
+        materials.insert(materials.end(), m.materials.begin(), m.materials.end());
+    }
+    if (instances.empty()) return;
+
+    // fit the union of the instance spheres into the unit sphere, like Model::normalize
+    Vec3 lo = instances[0].center, hi = lo;
+    for (const Instance& inst : instances) {
+        Vec3 c = inst.center;
+        float r = inst.radius;
+        lo = {std::min(lo.x, c.x - r), std::min(lo.y, c.y - r), std::min(lo.z, c.z - r)};
+        hi = {std::max(hi.x, c.x + r), std::max(hi.y, c.y + r), std::max(hi.z, c.z + r)};
+    }
+    Vec3 center = (lo + hi) * 0.5f;
+    float radius = 0;
+    for (const Instance& inst : instances) radius = std::max(radius, (inst.center - center).mag() + inst.radius);
+
+    float k = 1.0f / radius;
+    Projection fit = Projection::placement(center * -k, k, 0, 0, 0);
+    for (Instance& inst : instances) {
+        inst.transform = fit * inst.transform;
+        inst.scale *= k;
+        inst.center = (inst.center - center) * k;
+        inst.radius *= k;
+    }
+}
+
+size_t Scene::vertexCount() const {
+    size_t n = 0;
+    for (const Model& m : meshes) n += m.vertices.size();
+    return n;
+}
+
+size_t Scene::faceCount() const {
+    size_t n = 0;
+    for (const Instance& inst : instances) n += meshes[inst.mesh].levelFaceCount(0);
+    return n;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "model.hpp"
+#include "projection.hpp"
+#include <string>
+#include <vector>
+
+// one placement of a shared mesh
+struct Instance {
+    uint32_t mesh;
+    Projection transform;  // mesh -> scene space
+    float scale;           // uniform scale inside transform
+    // bounding sphere in scene space
+    Vec3 center;
+    float radius;
+};
+
+// meshes loaded once and placed any number of times; the whole scene fits the unit sphere
+class Scene {
+public:
+    std::vector<Model> meshes;
+    std::vector<Instance> instances;
+    // materials of every mesh, concatenated; mesh i starts at material_offsets[i]
+    std::vector<Material> materials;
+    std::vector<int> material_offsets;
+
+    // a .scene description, or a single model file placed once at the origin
+    static Scene load(const std::string& filename, const LoadOptions& opts);
+    static Scene single(Model model);
+    static bool isDescription(const std::string& filename);
+
+    // full-resolution vertices stored and triangles drawn per frame
+    size_t vertexCount() const;
+    size_t faceCount() const;
+
+private:
+    static Scene loadDescription(const std::string& filename, const LoadOptions& opts);
+    void finish();
+};
@@ -0,0 +1,204 @@
+#include "model.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+
+namespace {
+    // stop once a level gets this small, or when a pass cannot remove enough
+    constexpr size_t MIN_LOD_FACES = 1000;
+    constexpr float MIN_REDUCTION = 0.8f;
+    constexpr int MAX_PASSES = 32;
+
+    // symmetric 4x4 plane quadric, upper triangle
+    struct Quadric {
+        double q[10] = {};
+
+        void addPlane(const Vec3& n, double d, double w) {
+            double a = n.x, b = n.y, c = n.z;
+            double vals[10] = {a*a, a*b, a*c, a*d, b*b, b*c, b*d, c*c, c*d, d*d};
+            for (int i = 0; i < 10; ++i) q[i] += w * vals[i];
+        }
+
+        Quadric& operator+=(const Quadric& o) {
+            for (int i = 0; i < 10; ++i) q[i] += o.q[i];
+            return *this;
+        }
+
+        // squared distance to the accumulated planes
+        double eval(const Vec3& v) const {
+            double x = v.x, y = v.y, z = v.z;
+            return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x
+                 + q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y
+                 + q[7]*z*z + 2*q[8]*z
+                 + q[9];
+        }
+    };
+
+    struct Collapse {
+        double cost;
+        int from, to;
+        bool operator<(const Collapse& o) const { return cost < o.cost; }
+    };
+
+    uint64_t edgeKey(int a, int b) {
+        return ((uint64_t)std::min(a, b) << 32) | (uint32_t)std::max(a, b);
+    }
+
+    // half-edge collapses (vertices never move, so every level shares the vertex array)
+    // until faces.size() <= target; returns the largest collapse error
+    float simplify(const std::vector<Vec3>& verts, std::vector<Face>& faces, size_t target) {
+        size_t nv = verts.size();
+
+        std::vector<Quadric> quadrics(nv);
+        for (const auto& f : faces) {
+            const Vec3& a = verts[f.idxs[0]];
+            Vec3 n = (verts[f.idxs[1]] - a).cross(verts[f.idxs[2]] - a);
+            float area2 = n.mag();
+            if (area2 == 0) continue;
+            n = n * (1.0f / area2);
+            for (int idx : f.idxs) quadrics[idx].addPlane(n, -n.dot(a), area2);
+        }
+
+        // lock vertices on material borders and open or non-manifold edges
+        std::vector<uint8_t> locked(nv, 0);
+        std::vector<int> vertex_mat(nv, std::numeric_limits<int>::min());
+        std::vector<uint64_t> edges;
+        edges.reserve(faces.size() * 3);
+        for (const auto& f : faces) {
+            for (int k = 0; k < 3; ++k) {
+                int v = f.idxs[k];
+                if (vertex_mat[v] == std::numeric_limits<int>::min()) vertex_mat[v] = f.material_idx;
+                else if (vertex_mat[v] != f.material_idx) locked[v] = 1;
+                edges.push_back(edgeKey(v, f.idxs[(k + 1) % 3]));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();) {
+            size_t j = i;
+            while (j < edges.size() && edges[j] == edges[i]) ++j;
+            if (j - i != 2) {
+                locked[edges[i] >> 32] = 1;
+                locked[(uint32_t)edges[i]] = 1;
+            }
+            i = j;
+        }
+
+        double max_cost = 0;
+        std::vector<int> remap(nv);
+        std::iota(remap.begin(), remap.end(), 0);
+        std::vector<uint32_t> adj_start(nv + 1), adj;
+        std::vector<uint8_t> touched(nv);
+        std::vector<Collapse> candidates;
+
+        for (int pass = 0; pass < MAX_PASSES && faces.size() > target; ++pass) {
+            // vertex -> face adjacency
+            std::fill(adj_start.begin(), adj_start.end(), 0);
+            for (const auto& f : faces) {
+                for (int idx : f.idxs) ++adj_start[idx + 1];
+            }
+            std::partial_sum(adj_start.begin(), adj_start.end(), adj_start.begin());
+            adj.resize(faces.size() * 3);
+            {
+                std::vector<uint32_t> fill(adj_start.begin(), adj_start.end() - 1);
+                for (size_t fi = 0; fi < faces.size(); ++fi) {
+                    for (int idx : faces[fi].idxs) adj[fill[idx]++] = fi;
+                }
+            }
+
+            // cheapest direction of every unique edge
+            edges.clear();
+            for (const auto& f : faces) {
+                for (int k = 0; k < 3; ++k) edges.push_back(edgeKey(f.idxs[k], f.idxs[(k + 1) % 3]));
+            }
+            std::sort(edges.begin(), edges.end());
+            edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+            candidates.clear();
+            for (uint64_t e : edges) {
+                int a = e >> 32, b = (uint32_t)e;
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+                double to_b = locked[a] ? -1 : q.eval(verts[b]);
+                double to_a = locked[b] ? -1 : q.eval(verts[a]);
+                if (to_b >= 0 && (to_a < 0 || to_b <= to_a)) candidates.push_back({to_b, a, b});
+                else if (to_a >= 0) candidates.push_back({to_a, b, a});
+            }
+            std::sort(candidates.begin(), candidates.end());
+
+            // independent collapses: each one-ring changes at most once per pass
+            std::fill(touched.begin(), touched.end(), 0);
+            size_t needed = faces.size() - target, removed = 0;
+            int collapsed = 0;
+            for (const auto& c : candidates) {
+                if (removed >= needed) break;
+                int u = c.from, v = c.to;
+                if (touched[u] || touched[v]) continue;
+
+                // reject collapses that flip a surviving face
+                bool ok = true;
+                int dying = 0;
+                for (uint32_t k = adj_start[u]; k < adj_start[u + 1] && ok; ++k) {
+                    const Face& f = faces[adj[k]];
+                    if (f.idxs[0] == v || f.idxs[1] == v || f.idxs[2] == v) {
+                        ++dying;
+                        continue;
+                    }
+                    Vec3 p[3], q[3];
+                    for (int i = 0; i < 3; ++i) {
+                        p[i] = verts[f.idxs[i]];
+                        q[i] = verts[f.idxs[i] == u ? v : f.idxs[i]];
+                    }
+                    Vec3 before = (p[1] - p[0]).cross(p[2] - p[0]);
+                    Vec3 after = (q[1] - q[0]).cross(q[2] - q[0]);
+                    ok = before.dot(after) > 0;
+                }
+                if (!ok) continue;
+
+                remap[u] = v;
+                quadrics[v] += quadrics[u];
+                max_cost = std::max(max_cost, c.cost);
+                touched[u] = touched[v] = 1;
+                for (uint32_t k = adj_start[u]; k < adj_start[u + 1]; ++k) {
+                    for (int idx : faces[adj[k]].idxs) touched[idx] = 1;
+                }
+                removed += dying;
+                ++collapsed;
+            }
+            if (collapsed == 0) break;
+
+            size_t out = 0;
+            for (auto& f : faces) {
+                Face nf = {{remap[f.idxs[0]], remap[f.idxs[1]], remap[f.idxs[2]]}, f.material_idx};
+                if (nf.idxs[0] == nf.idxs[1] || nf.idxs[1] == nf.idxs[2] || nf.idxs[0] == nf.idxs[2]) continue;
+                faces[out++] = nf;
+            }
+            faces.resize(out);
+        }
+
+        return (float)std::sqrt(std::max(0.0, max_cost));
+    }
+}
+
+void Model::buildLods() {
+    lods = buildLods(vertices, faces);
+}
+
+std::vector<Lod> Model::buildLods(const std::vector<Vec3>& vertices, const std::vector<Face>& faces) {
+    std::vector<Lod> lods;
+    std::vector<Face> level = faces;
+    while (level.size() >= 2 * MIN_LOD_FACES) {
+        std::vector<Face> coarse = level;
+        float error = simplify(vertices, coarse, level.size() / 2);
+        if (coarse.size() > level.size() * MIN_REDUCTION) break;
+
+        Lod lod;
+        lod.error = error + (lods.empty() ? 0.0f : lods.back().error);
+        buildMeshlets(vertices, coarse, lod.face_normals, lod.meshlets);
+        lod.indices.append(coarse, vertices.size());
+        lods.push_back(std::move(lod));
+        level = std::move(coarse);
+    }
+    return lods;
+}
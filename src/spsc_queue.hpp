@@ -0,0 +1,36 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// bounded single-producer single-consumer ring; push and pop never lock or block
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+    // false when full; v is left untouched
+    bool push(T& v) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) return false;
+        slots[t & (N - 1)] = std::move(v);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // false when empty
+    bool pop(T& v) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        v = std::move(slots[h & (N - 1)]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, N> slots;
+    // each index is written by one side only; separate cache lines keep them from bouncing
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
@@ -0,0 +1,493 @@
+#include "stream_loader.hpp"
+#include "obj_parse.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+    // file bytes parsed per published chunk, about 100k triangles of a typical obj
+    constexpr size_t STREAM_CHUNK = 4 << 20;
+
+    // a closed surface spanning res grid cells per axis touches about 3 res^2 cells and
+    // clusters into 2 triangles per cell
+    constexpr float FACES_PER_CELL2 = 6.0f;
+    // cell growth each time the resident copy exceeds its budget (halves the triangles)
+    constexpr float COARSEN = 1.41421356f;
+    constexpr int CELL_BITS = 21;
+    // source vertices whose bounding box sizes the clustering grid when no face comes first
+    constexpr size_t GRID_SAMPLE = 1 << 16;
+
+    // a resident triangle by its sorted cluster ids, for dropping repeats
+    struct FaceKey {
+        int a, b, c;
+
+        FaceKey(int x, int y, int z) {
+            if (x > y) std::swap(x, y);
+            if (y > z) std::swap(y, z);
+            if (x > y) std::swap(x, y);
+            a = x, b = y, c = z;
+        }
+        bool operator==(const FaceKey& o) const { return a == o.a && b == o.b && c == o.c; }
+    };
+
+    struct FaceKeyHash {
+        size_t operator()(const FaceKey& k) const {
+            uint64_t h = (uint32_t)k.a;
+            h = h * 0x9E3779B97F4A7C15ull ^ (uint32_t)k.b;
+            h = h * 0x9E3779B97F4A7C15ull ^ (uint32_t)k.c;
+            return h ^ (h >> 29);
+        }
+    };
+
+    void grow(Vec3& lo, Vec3& hi, const Vec3& v) {
+        lo = {std::min(lo.x, v.x), std::min(lo.y, v.y), std::min(lo.z, v.z)};
+        hi = {std::max(hi.x, v.x), std::max(hi.y, v.y), std::max(hi.z, v.z)};
+    }
+}
+
+// turns parsed vertices and polygons into MeshChunks; with a budget, vertices are snapped to
+// one representative per grid cell and triangles that collapse or repeat are dropped
+class ChunkBuilder {
+public:
+    explicit ChunkBuilder(size_t budget) : budget(budget) {}
+
+    // source vertices added so far, the index space of addPolygon
+    size_t vertexCount() const { return clustered ? cluster_of.size() : positions.size(); }
+    void addVertex(const Vec3& v);
+    void addPolygon(const std::vector<int>& idxs, int mat);
+    // unindexed input (stl), never kept at full resolution when clustering
+    void addTriangle(const Vec3& a, const Vec3& b, const Vec3& c, int mat);
+    // sizes the clustering grid for geometry spanning [lo, hi]; the first call wins
+    void placeGrid(const Vec3& lo, const Vec3& hi);
+    // everything added since the previous take, with normals and meshlets
+    std::unique_ptr<MeshChunk> take(float progress);
+    // simplified levels of the resident copy; leaves the builder empty
+    std::vector<Lod> buildLods();
+
+private:
+    // grid sized by the bounding box of the vertices buffered so far
+    void placeGridFromPositions();
+    uint32_t clusterOf(const Vec3& v);
+    void addResident(Face f);
+    void coarsen();
+
+    size_t budget;
+    PolyScratch scratch;
+    std::vector<int> poly;
+    std::vector<Face> tris;
+
+    // full mesh: every vertex (faces may refer to any of them); clustered: at most
+    // GRID_SAMPLE vertices read before the grid was placed
+    std::vector<Vec3> positions;
+    std::vector<Face> faces;  // full mesh, not yet published
+    size_t published_vertices = 0;
+
+    bool clustered = false;
+    Vec3 origin;
+    float cell = 1;
+    std::vector<uint32_t> cluster_of;  // per source vertex
+    std::unordered_map<uint64_t, uint32_t> cells;
+    std::vector<Vec3> reps;             // first vertex to land in each cell
+    std::vector<Face> resident;
+    std::unordered_set<FaceKey, FaceKeyHash> face_keys;
+    size_t published_faces = 0;
+    bool reset = false;
+};
+
+void ChunkBuilder::addVertex(const Vec3& v) {
+    if (!clustered) {
+        positions.push_back(v);
+        if (budget && positions.size() >= GRID_SAMPLE) placeGridFromPositions();
+        return;
+    }
+    cluster_of.push_back(clusterOf(v));
+    // a grid sized from the first vertices alone can be far too fine for the whole mesh
+    if (reps.size() > budget) coarsen();
+}
+
+void ChunkBuilder::addPolygon(const std::vector<int>& idxs, int mat) {
+    if (budget == 0) {
+        triangulateFace(positions, idxs, mat, scratch, faces);
+        return;
+    }
+
+    if (!clustered) placeGridFromPositions();
+
+    poly.clear();
+    for (int i : idxs) poly.push_back(cluster_of[i]);
+    tris.clear();
+    triangulateFace(reps, poly, mat, scratch, tris);
+    for (const Face& f : tris) addResident(f);
+    if (resident.size() > budget) coarsen();
+}
+
+void ChunkBuilder::addTriangle(const Vec3& a, const Vec3& b, const Vec3& c, int mat) {
+    if (budget == 0) {
+        int n = positions.size();
+        positions.insert(positions.end(), {a, b, c});
+        faces.push_back({{n, n + 1, n + 2}, mat});
+        return;
+    }
+
+    if (!clustered) {
+        Vec3 lo = a, hi = a;
+        grow(lo, hi, b);
+        grow(lo, hi, c);
+        placeGrid(lo, hi);
+    }
+    addResident({{(int)clusterOf(a), (int)clusterOf(b), (int)clusterOf(c)}, mat});
+    if (resident.size() > budget) coarsen();
+}
+
+void ChunkBuilder::placeGrid(const Vec3& lo, const Vec3& hi) {
+    if (budget == 0 || clustered) return;
+    clustered = true;
+
+    Vec3 ext = hi - lo;
+    float res = std::max(1.0f, std::sqrt(budget / FACES_PER_CELL2));
+    float longest = std::max({ext.x, ext.y, ext.z});
+    origin = lo;
+    cell = longest > 0 ? longest / res : 1.0f;
+
+    for (const Vec3& v : positions) cluster_of.push_back(clusterOf(v));
+    std::vector<Vec3>().swap(positions);
+}
+
+void ChunkBuilder::placeGridFromPositions() {
+    // obj files usually list every vertex first, so the sample is spread over the mesh; the
+    // grid coarsens later if it turns out too fine
+    Vec3 lo = positions.empty() ? Vec3() : positions[0], hi = lo;
+    for (const Vec3& v : positions) grow(lo, hi, v);
+    placeGrid(lo, hi);
+}
+
+uint32_t ChunkBuilder::clusterOf(const Vec3& v) {
+    auto coord = [&](float x, float o) {
+        int64_t c = (int64_t)std::floor((x - o) / cell) + (1 << (CELL_BITS - 1));
+        return (uint64_t)std::clamp<int64_t>(c, 0, (1 << CELL_BITS) - 1);
+    };
+    uint64_t key = coord(v.x, origin.x) | (coord(v.y, origin.y) << CELL_BITS) | (coord(v.z, origin.z) << (2 * CELL_BITS));
+
+    auto [it, added] = cells.try_emplace(key, (uint32_t)reps.size());
+    if (added) reps.push_back(v);
+    return it->second;
+}
+
+void ChunkBuilder::addResident(Face f) {
+    auto [a, b, c] = f.idxs;
+    if (a == b || b == c || a == c) return;
+    if (face_keys.insert(FaceKey(a, b, c)).second) resident.push_back(f);
+}
+
+void ChunkBuilder::coarsen() {
+    // a surface clusters into about two triangles per cell, so more cells than the budget
+    // also means the grid is too fine
+    while (resident.size() > budget || reps.size() > budget) {
+        cell *= COARSEN;
+        std::vector<Vec3> old = std::move(reps);
+        reps.clear();
+        cells.clear();
+
+        std::vector<uint32_t> remap(old.size());
+        for (size_t i = 0; i < old.size(); ++i) remap[i] = clusterOf(old[i]);
+        for (uint32_t& c : cluster_of) c = remap[c];
+
+        std::vector<Face> old_faces = std::move(resident);
+        resident.clear();
+        face_keys.clear();
+        for (Face f : old_faces) {
+            for (int& i : f.idxs) i = remap[i];
+            addResident(f);
+        }
+    }
+
+    // everything published so far refers to the old clusters
+    reset = true;
+    published_vertices = 0;
+    published_faces = 0;
+}
+
+std::unique_ptr<MeshChunk> ChunkBuilder::take(float progress) {
+    auto chunk = std::make_unique<MeshChunk>();
+    chunk->progress = progress;
+
+    // a clustered copy has no vertices to show until the grid is placed
+    const std::vector<Vec3>& verts = budget ? reps : positions;
+    chunk->vertices.assign(verts.begin() + published_vertices, verts.end());
+    published_vertices = verts.size();
+
+    if (budget) {
+        chunk->reset = reset;
+        reset = false;
+        chunk->faces.assign(resident.begin() + published_faces, resident.end());
+        published_faces = resident.size();
+    } else {
+        chunk->faces = std::move(faces);
+        faces.clear();
+    }
+
+    Model::buildMeshlets(verts, chunk->faces, chunk->face_normals, chunk->meshlets);
+    return chunk;
+}
+
+std::vector<Lod> ChunkBuilder::buildLods() {
+    std::vector<Lod> lods = Model::buildLods(reps, resident);
+    std::vector<Vec3>().swap(reps);
+    std::vector<Face>().swap(resident);
+    return lods;
+}
+
+// loader
+
+StreamLoader::StreamLoader(const std::string& filename, const LoadOptions& opts, size_t resident_faces)
+    : filename(filename), opts(opts), budget(resident_faces), file(filename) {
+    if (file.isOpen()) thread = std::thread(&StreamLoader::run, this);
+}
+
+StreamLoader::~StreamLoader() {
+    stopping = true;
+    if (thread.joinable()) thread.join();
+}
+
+void StreamLoader::run() {
+    // the mesh is on screen already, so the slow simplification runs last
+    std::unique_ptr<MeshChunk> last;
+    {
+        ChunkBuilder out(budget);
+        if (filename.find(".obj") != std::string::npos) loadObj(out);
+        else loadStl(out);
+
+        last = out.take(1.0f);
+        last->complete = true;
+        if (budget) {
+            if (!stopping) last->lods = out.buildLods();
+            last->last = true;
+        }
+    }
+    publish(std::move(last));
+    if (budget) return;
+
+    // the full mesh is only kept once, on the render side: simplify it from there when poll
+    // has put it together
+    const Model* mesh;
+    while (!(mesh = final_mesh.load(std::memory_order_acquire))) {
+        if (stopping) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // meshlets carry the materials the index buffer drops
+    std::vector<Face> faces(mesh->indices.faceCount());
+    for (size_t f = 0; f < faces.size(); ++f) {
+        for (int k = 0; k < 3; ++k) faces[f].idxs[k] = mesh->indices[f * 3 + k];
+    }
+    for (const Meshlet& ml : mesh->meshlets) {
+        for (uint32_t f = ml.first_face; f < ml.first_face + ml.face_count; ++f) faces[f].material_idx = ml.material;
+    }
+
+    auto lods = std::make_unique<MeshChunk>();
+    lods->progress = 1.0f;
+    lods->last = true;
+    if (!stopping) lods->lods = Model::buildLods(mesh->vertices, faces);
+    publish(std::move(lods));
+}
+
+void StreamLoader::publish(std::unique_ptr<MeshChunk> chunk) {
+    while (!queue.push(chunk)) {
+        if (stopping) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void StreamLoader::loadObj(ChunkBuilder& out) {
+    std::vector<Material> materials;
+    size_t sent_materials = 0;
+    std::unordered_map<std::string, int> mat_lookup;
+    auto findMat = [&](std::string_view name) {
+        auto it = mat_lookup.find(std::string(name));
+        return it == mat_lookup.end() ? -1 : it->second;
+    };
+
+    // faces naming vertices further down the file wait for them, as the batch loader has
+    // every vertex at hand; those still waiting at the end are dropped like its out of
+    // range faces
+    struct Pending {
+        std::vector<int> idxs;
+        int mat;
+        int64_t needs;  // vertex count that resolves every index
+    };
+    std::vector<Pending> pending;
+
+    int active = -1;
+    std::vector<int> resolved;
+    const char* p = file.begin();
+    while (p < file.end() && !stopping) {
+        const char* end = lineEnd(p + std::min(STREAM_CHUNK, (size_t)(file.end() - p)), file.end());
+        end = (end < file.end()) ? end + 1 : file.end();
+
+        ObjChunk c;
+        parseObjChunk(p, end, opts.colors, c);
+
+        for (auto lib : c.mtllibs) {
+            loadMtl(siblingPath(filename, std::string(lib)), materials);
+            for (size_t i = 0; i < materials.size(); ++i) mat_lookup.emplace(materials[i].name, (int)i);
+        }
+        std::vector<int> slot_mats;
+        for (auto name : c.usemtl) slot_mats.push_back(findMat(name));
+
+        // same orientation fix as Model::load: z is inverted and the winding flipped
+        size_t offset = out.vertexCount();
+        for (const Vec3& v : c.vertices) out.addVertex({v.x, v.y, -v.z});
+        int64_t available = out.vertexCount();
+
+        size_t waiting = 0;
+        for (Pending& f : pending) {
+            if (f.needs <= available) out.addPolygon(f.idxs, f.mat);
+            else pending[waiting++] = std::move(f);
+        }
+        pending.resize(waiting);
+
+        for (const auto& f : c.faces) {
+            int64_t seen = offset + f.vertices_before;
+            int64_t needs = 0;
+            resolved.clear();
+            for (uint32_t k = f.count; k-- > 0;) {
+                int idx = c.idxs[f.first + k];
+                // relative indices only reach back, absolute ones may point ahead
+                int64_t g = (idx < 0) ? seen + idx : (int64_t)idx - 1;
+                if (g < 0 || g > INT32_MAX) break;
+                needs = std::max(needs, g + 1);
+                resolved.push_back((int)g);
+            }
+            if (resolved.size() != f.count) continue;
+            int mat = f.mat_slot < 0 ? active : slot_mats[f.mat_slot];
+            if (needs <= available) out.addPolygon(resolved, mat);
+            else pending.push_back({resolved, mat, needs});
+        }
+        if (!slot_mats.empty()) active = slot_mats.back();
+
+        file.discardBefore(end);
+        p = end;
+
+        auto chunk = out.take((float)(p - file.begin()) / file.size());
+        chunk->materials.assign(materials.begin() + sent_materials, materials.end());
+        sent_materials = materials.size();
+        publish(std::move(chunk));
+    }
+}
+
+void StreamLoader::loadStl(ChunkBuilder& out) {
+    if (file.size() < 84) return;
+
+    uint32_t count;
+    std::memcpy(&count, file.data() + 80, 4);
+    bool binary = (84 + (uint64_t)count * 50 == file.size()) || std::strncmp(file.data(), "solid", 5) != 0;
+
+    // corners of the triangles parsed from one chunk, already in model orientation
+    std::vector<Vec3> corners;
+    bool first = true;
+    auto flush = [&](const char* consumed) {
+        if (first && !corners.empty()) {
+            // the first chunk sizes the clustering grid, later chunks coarsen it as needed
+            Vec3 lo = corners[0], hi = lo;
+            for (const Vec3& v : corners) grow(lo, hi, v);
+            out.placeGrid(lo, hi);
+            first = false;
+        }
+        for (size_t i = 0; i + 2 < corners.size(); i += 3) out.addTriangle(corners[i], corners[i + 2], corners[i + 1], -1);
+        corners.erase(corners.begin(), corners.begin() + corners.size() / 3 * 3);
+
+        file.discardBefore(consumed);
+        publish(out.take((float)(consumed - file.begin()) / file.size()));
+    };
+
+    if (binary) {
+        // 50 byte records of normal(3) + 3 verts(9) floats + 2 bytes attribute
+        count = std::min<uint64_t>(count, (file.size() - 84) / 50);
+        const char* rec = file.data() + 84;
+        for (uint32_t i = 0; i < count && !stopping;) {
+            uint32_t end = std::min<uint64_t>(count, i + STREAM_CHUNK / 50);
+            for (; i < end; ++i, rec += 50) {
+                float buffer[12];
+                std::memcpy(buffer, rec, sizeof(buffer));
+                for (int v = 0; v < 3; ++v) corners.push_back({buffer[3 + v*3], buffer[5 + v*3], buffer[4 + v*3]}); // swap Y/Z
+            }
+            flush(rec);
+        }
+    } else {
+        const char* p = file.begin();
+        while (p < file.end() && !stopping) {
+            const char* stop = p + std::min(STREAM_CHUNK, (size_t)(file.end() - p));
+            while (p < stop) {
+                const char* eol = lineEnd(p, file.end());
+                if (nextToken(p, eol) == "vertex") {
+                    float x = nextFloat(p, eol);
+                    float y = nextFloat(p, eol);
+                    float z = nextFloat(p, eol);
+                    corners.emplace_back(x, z, y);
+                }
+                p = (eol < file.end()) ? eol + 1 : file.end();
+            }
+            flush(p);
+        }
+    }
+}
+
+bool StreamLoader::poll(Scene& scene) {
+    if (scene.meshes.empty()) {
+        scene.meshes.emplace_back();
+        scene.material_offsets = {0};
+        scene.instances.push_back({0, Projection::placement({0, 0, 0}, 1.0f, 0, 0, 0), 1.0f, {0, 0, 0}, 1.0f});
+    }
+
+    Model& m = scene.meshes[0];
+    bool changed = false;
+    std::unique_ptr<MeshChunk> c;
+    while (queue.pop(c)) {
+        if (c->reset) {
+            m.vertices.clear();
+            m.indices.clear();
+            m.face_normals.clear();
+            m.meshlets.clear();
+        }
+        if (m.vertices.empty() && !c->vertices.empty()) lo = hi = c->vertices[0];
+        for (const Vec3& v : c->vertices) grow(lo, hi, v);
+
+        uint32_t base = m.indices.faceCount();
+        for (Meshlet ml : c->meshlets) {
+            ml.first_face += base;
+            m.meshlets.push_back(ml);
+        }
+        m.vertices.insert(m.vertices.end(), c->vertices.begin(), c->vertices.end());
+        m.indices.append(c->faces, m.vertices.size());
+        m.face_normals.insert(m.face_normals.end(), c->face_normals.begin(), c->face_normals.end());
+        m.materials.insert(m.materials.end(), c->materials.begin(), c->materials.end());
+        scene.materials.insert(scene.materials.end(), c->materials.begin(), c->materials.end());
+
+        if (c->last) m.lods = std::move(c->lods);
+        // vertices and faces are final, the loader may read them from now on
+        if (c->complete) final_mesh.store(&m, std::memory_order_release);
+
+        read = c->progress;
+        finished = c->last;
+        changed = true;
+    }
+
+    if (changed && !m.vertices.empty()) {
+        // running normalization: the bounding box seen so far is fitted into the unit sphere,
+        // and the finished mesh by its farthest vertex like Model::normalize
+        Vec3 center = (lo + hi) * 0.5f;
+        float radius = (hi - lo).mag() * 0.5f;
+        if (finished) {
+            radius = 0;
+            for (const Vec3& v : m.vertices) radius = std::max(radius, (v - center).mag());
+        }
+        float k = radius > 0 ? 1.0f / radius : 1.0f;
+        Instance& inst = scene.instances[0];
+        inst.transform = Projection::placement(center * -k, k, 0, 0, 0);
+        inst.scale = k;
+    }
+    return changed;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "mapped_file.hpp"
+#include "model.hpp"
+#include "scene.hpp"
+#include "spsc_queue.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+class ChunkBuilder;
+
+// geometry published by the loader thread; face indices count every vertex published
+// since the last reset
+struct MeshChunk {
+    bool reset = false;     // drop everything published before (the resident copy was coarsened)
+    bool complete = false;  // every triangle has been published
+    bool last = false;      // nothing follows
+    float progress = 0;   // fraction of the file read
+    std::vector<Vec3> vertices;
+    std::vector<Face> faces;
+    std::vector<Vec3> face_normals;
+    std::vector<Meshlet> meshlets;    // first_face relative to this chunk
+    std::vector<Material> materials;  // loaded since the previous chunk
+    std::vector<Lod> lods;            // last chunk only, over everything published
+                                      // (without a budget, a chunk of its own after the mesh)
+};
+
+// parses a model on a background thread and hands it to the render loop in chunks, so
+// drawing starts right away. with a resident budget the loader keeps only a vertex-clustered
+// copy of about that many triangles and never holds the full-resolution faces. without one it
+// keeps no faces either, and builds the lods from the polled mesh, so the scene passed to poll
+// must outlive the loader
+class StreamLoader {
+public:
+    // resident_faces = 0 keeps the full mesh
+    StreamLoader(const std::string& filename, const LoadOptions& opts, size_t resident_faces);
+    ~StreamLoader();
+
+    StreamLoader(const StreamLoader&) = delete;
+    StreamLoader& operator=(const StreamLoader&) = delete;
+
+    bool isOpen() const { return file.isOpen(); }
+    // moves everything published so far into scene (one mesh, one instance, created on first
+    // use) and refits it to the unit sphere; true when the scene changed
+    bool poll(Scene& scene);
+    bool done() const { return finished; }
+    float progress() const { return read; }
+
+private:
+    void run();
+    void loadObj(ChunkBuilder& out);
+    void loadStl(ChunkBuilder& out);
+    // hands a chunk over, waiting while the queue is full
+    void publish(std::unique_ptr<MeshChunk> chunk);
+
+    std::string filename;
+    LoadOptions opts;
+    size_t budget;
+    MappedFile file;
+
+    SpscQueue<std::unique_ptr<MeshChunk>, 8> queue;
+    std::atomic<bool> stopping{false};
+    // the polled mesh once it is complete, read by the loader to build lods
+    std::atomic<const Model*> final_mesh{nullptr};
+    std::thread thread;
+
+    // render thread state
+    bool finished = false;
+    float read = 0;
+    Vec3 lo, hi;
+};
@@ -1,19 +1,78 @@
 #include "surface.hpp"
-#include <iostream>
 #include <cmath>
 #include <algorithm>
 #include <array>
-#include <ncurses.h>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+    // half-space rasterizer works on a 1/16 cell grid
+    constexpr int SUB_BITS = 4;
+    constexpr int SUB = 1 << SUB_BITS;
+    // largest triangle extent (in subcells) whose edge functions still fit in 32 bits
+    constexpr int64_t MAX_EXTENT = 1 << 14;
+
+    // sums runs of sx sample columns into cells; fixed widths unroll
+    template <int SX>
+    void foldColumns(const uint16_t* sum, const uint16_t* count, int cells, int32_t* cell_sum, int32_t* cell_count) {
+        for (int x = 0; x < cells; ++x) {
+            int s = 0, n = 0;
+            for (int k = 0; k < SX; ++k) {
+                s += sum[x * SX + k];
+                n += count[x * SX + k];
+            }
+            cell_sum[x] = s;
+            cell_count[x] = n;
+        }
+    }
+
+    void foldColumns(const uint16_t* sum, const uint16_t* count, int cells, int sx, int32_t* cell_sum, int32_t* cell_count) {
+        for (int x = 0; x < cells; ++x) {
+            int s = 0, n = 0;
+            for (int k = 0; k < sx; ++k) {
+                s += sum[x * sx + k];
+                n += count[x * sx + k];
+            }
+            cell_sum[x] = s;
+            cell_count[x] = n;
+        }
+    }
+
+    int64_t floorDiv(int64_t a, int64_t b) {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    // after a depth prepass the stored depth is the triangle's own where it is nearest
+    template <unsigned F>
+    bool depthPasses(float z, float stored) {
+        return (F & RASTER_DEPTH_EQUAL) ? z <= stored : z < stored;
+    }
+}
 
 Surface::Surface(int w, int h, float lw, float lh) 
     : width(w), height(h), logical_w(lw), logical_h(lh) {
     dx = logical_w / width;
     dy = logical_h / height;
-    pixels.resize(width * height);
+    depth.resize(width * height);
+    glyphs.resize(width * height);
+    materials.resize(width * height);
+    hiz_w = (width + HIZ_W - 1) / HIZ_W;
+    hiz_h = (height + HIZ_H - 1) / HIZ_H;
+    hiz_max.resize(hiz_w * hiz_h);
+    hiz_dirty.resize(hiz_w * hiz_h);
 }
 
-void Surface::clear() {
-    std::fill(pixels.begin(), pixels.end(), Pixel{});
+void Surface::clear(char background, unsigned features) {
+    // plain fills over each plane vectorize; -1 materials are all-ones bytes
+    std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::infinity());
+    std::memset(glyphs.data(), background, glyphs.size());
+    if (features & RASTER_COLOR) std::memset(materials.data(), 0xFF, materials.size() * sizeof(int16_t));
+    std::fill(hiz_max.begin(), hiz_max.end(), std::numeric_limits<float>::infinity());
+    std::fill(hiz_dirty.begin(), hiz_dirty.end(), 0);
 }
 
 int Surface::idxX(float x) const {
@@ -24,10 +83,96 @@ int Surface::idxY(float y) const {
     return std::clamp((int)std::floor(y / dy), 0, height - 1);
 }
 
-void Surface::drawTriangle(const Triangle& inTri, char c, int mat_idx) {
+bool Surface::backfacing(const Triangle& t) {
+    return (t.p2.x - t.p1.x) * (t.p3.y - t.p2.y) >= 
+           (t.p3.x - t.p2.x) * (t.p2.y - t.p1.y);
+}
+
+Rect Surface::bounds(const Triangle& t) const {
+    return {
+        idxX(std::min({t.p1.x, t.p2.x, t.p3.x})),
+        idxY(std::min({t.p1.y, t.p2.y, t.p3.y})),
+        idxX(std::max({t.p1.x, t.p2.x, t.p3.x})),
+        idxY(std::max({t.p1.y, t.p2.y, t.p3.y}))
+    };
+}
+
+Rect Surface::bounds(const Vec3& lo, const Vec3& hi) const {
+    return {idxX(lo.x), idxY(lo.y), idxX(hi.x), idxY(hi.y)};
+}
+
+void Surface::markDirty(const Rect& r) {
+    for (int by = r.y0 / HIZ_H; by <= r.y1 / HIZ_H; ++by) {
+        for (int bx = r.x0 / HIZ_W; bx <= r.x1 / HIZ_W; ++bx) hiz_dirty[by * hiz_w + bx] = 1;
+    }
+}
+
+void Surface::refreshBlock(int bx, int by) {
+    int x0 = bx * HIZ_W, x1 = std::min(x0 + HIZ_W, width);
+    int y0 = by * HIZ_H, y1 = std::min(y0 + HIZ_H, height);
+
+    float m = -std::numeric_limits<float>::infinity();
+    for (int y = y0; y < y1; ++y) {
+        const float* line = &depth[y * width];
+        for (int x = x0; x < x1; ++x) m = std::max(m, line[x]);
+    }
+    hiz_max[by * hiz_w + bx] = m;
+    hiz_dirty[by * hiz_w + bx] = 0;
+}
+
+bool Surface::occluded(const Rect& r, float min_z, bool ties_pass) {
+    auto visible = [&](int b) { return ties_pass ? min_z <= hiz_max[b] : min_z < hiz_max[b]; };
+    for (int by = r.y0 / HIZ_H; by <= r.y1 / HIZ_H; ++by) {
+        for (int bx = r.x0 / HIZ_W; bx <= r.x1 / HIZ_W; ++bx) {
+            int b = by * hiz_w + bx;
+            // a stale maximum is still an upper bound, so only refresh when it decides the test
+            if (visible(b) && hiz_dirty[b]) refreshBlock(bx, by);
+            if (visible(b)) return false;
+        }
+    }
+    return true;
+}
+
+template <unsigned F>
+RasterStats Surface::drawTriangle(const Triangle& tri, char c, int mat_idx) {
+    return drawTriangle<F>(tri, c, mat_idx, fullRect());
+}
+
+template <unsigned F>
+RasterStats Surface::drawTriangle(const Triangle& tri, char c, int mat_idx, const Rect& clip) {
     // basic orientation culling
-    if ((inTri.p2.x - inTri.p1.x) * (inTri.p3.y - inTri.p2.y) >= 
-        (inTri.p3.x - inTri.p2.x) * (inTri.p2.y - inTri.p1.y)) return;
+    if (backfacing(tri)) {
+        RasterStats stats;
+        stats.culled = 1;
+        return stats;
+    }
+
+    // reject triangles whose nearest point is behind every cell they could touch. refreshing
+    // a block costs about as much as shading it, so only triangles covering a block try
+    float w = std::max({tri.p1.x, tri.p2.x, tri.p3.x}) - std::min({tri.p1.x, tri.p2.x, tri.p3.x});
+    float h = std::max({tri.p1.y, tri.p2.y, tri.p3.y}) - std::min({tri.p1.y, tri.p2.y, tri.p3.y});
+    if (w * h >= HIZ_W * HIZ_H * dx * dy) {
+        Rect b = bounds(tri);
+        Rect r = {std::max(b.x0, clip.x0), std::max(b.y0, clip.y0), std::min(b.x1, clip.x1), std::min(b.y1, clip.y1)};
+        if (r.x0 <= r.x1 && r.y0 <= r.y1 && occluded(r, std::min({tri.p1.z, tri.p2.z, tri.p3.z}), F & RASTER_DEPTH_EQUAL)) {
+            RasterStats stats;
+            stats.occluded = 1;
+            return stats;
+        }
+    }
+
+    // scenes concatenate material tables, so indices can outgrow the 16-bit plane
+    if constexpr ((F & RASTER_COLOR) != 0) {
+        if (mat_idx > MAX_MATERIAL) mat_idx = -1;
+    }
+
+    if (mode == RasterMode::HalfSpace) return drawHalfSpace<F>(tri, c, mat_idx, clip);
+    return drawScanline<F>(tri, c, mat_idx, clip);
+}
+
+template <unsigned F>
+RasterStats Surface::drawScanline(const Triangle& inTri, char c, int mat_idx, const Rect& clip) {
+    RasterStats stats;
 
     // sort by X for scanning
     std::array<Vec3, 3> pts = {inTri.p1, inTri.p2, inTri.p3};
@@ -39,14 +184,15 @@ void Surface::drawTriangle(const Triangle& inTri, char c, int mat_idx) {
     float xi = pts[0].x + dx/2.0f;
     float xf = pts[2].x - dx/2.0f;
     
-    int x_start = idxX(xi);
-    int x_end = idxX(xf);
+    int x_start = std::max(idxX(xi), clip.x0);
+    int x_end = std::min(idxX(xf), clip.x1);
 
     auto getY = [&](const Vec3& pA, const Vec3& pB, float x) {
         if (pA.x == pB.x) return pA.y;
         return pA.y + (pB.y - pA.y) * (x - pA.x) / (pB.x - pA.x);
     };
 
+    int dirty_y0 = height, dirty_y1 = -1;
     for (int xx = x_start; xx <= x_end; ++xx) {
         float x = (xx + 0.5f) * dx;
         
@@ -57,51 +203,332 @@ void Surface::drawTriangle(const Triangle& inTri, char c, int mat_idx) {
         float yi = std::min(y1, y2);
         float yf = std::max(y1, y2);
 
-        int y_start = idxY(yi + dy/2.0f);
-        int y_end = idxY(yf - dy/2.0f);
+        int y_start = std::max(idxY(yi + dy/2.0f), clip.y0);
+        int y_end = std::min(idxY(yf - dy/2.0f), clip.y1);
+        if (y_end >= y_start) {
+            stats.tested += y_end - y_start + 1;
+            dirty_y0 = std::min(dirty_y0, y_start);
+            dirty_y1 = std::max(dirty_y1, y_end);
+        }
 
         for (int yy = y_start; yy <= y_end; ++yy) {
             float y = (yy + 0.5f) * dy;
-            float depth = pts[0].z - (normal.x * (x - pts[0].x) + normal.y * (y - pts[0].y)) / normal.z;
+            float z = pts[0].z - (normal.x * (x - pts[0].x) + normal.y * (y - pts[0].y)) / normal.z;
 
-            Pixel& p = pixels[yy * width + xx];
-            if (depth < p.z) {
-                p.z = depth;
-                p.c = c;
-                p.material = mat_idx;
+            int i = yy * width + xx;
+            if (depthPasses<F>(z, depth[i])) {
+                if constexpr (!(F & RASTER_DEPTH_EQUAL)) depth[i] = z;
+                if constexpr (!(F & RASTER_DEPTH_ONLY)) glyphs[i] = c;
+                if constexpr ((F & RASTER_COLOR) != 0) materials[i] = mat_idx;
+                ++stats.written;
             }
         }
     }
+    if (stats.written) markDirty({x_start, dirty_y0, x_end, dirty_y1});
+    return stats;
 }
 
-void Surface::print(bool color_support) const {
+template <unsigned F>
+RasterStats Surface::drawHalfSpace(const Triangle& t, char c, int mat_idx, const Rect& clip) {
+    const Vec3* v[3] = {&t.p1, &t.p2, &t.p3};
+
+    // snap to the subcell grid
+    int64_t fx[3], fy[3];
+    for (int i = 0; i < 3; ++i) {
+        float x = v[i]->x / dx * SUB, y = v[i]->y / dy * SUB;
+        if (!(std::abs(x) < 1e9f && std::abs(y) < 1e9f)) return drawScanline<F>(t, c, mat_idx, clip);
+        fx[i] = std::llround(x);
+        fy[i] = std::llround(y);
+    }
+
+    int64_t min_x = std::min({fx[0], fx[1], fx[2]}), max_x = std::max({fx[0], fx[1], fx[2]});
+    int64_t min_y = std::min({fy[0], fy[1], fy[2]}), max_y = std::max({fy[0], fy[1], fy[2]});
+
+    // outside the guard band the 32-bit edge functions could overflow
+    if (max_x - min_x > MAX_EXTENT || max_y - min_y > MAX_EXTENT) return drawScanline<F>(t, c, mat_idx, clip);
+
+    // cells whose centers fall inside the bounding box
+    int x0 = (int)std::max<int64_t>(clip.x0, floorDiv(min_x - SUB/2 + SUB - 1, SUB));
+    int x1 = (int)std::min<int64_t>(clip.x1, floorDiv(max_x - SUB/2, SUB));
+    int y0 = (int)std::max<int64_t>(clip.y0, floorDiv(min_y - SUB/2 + SUB - 1, SUB));
+    int y1 = (int)std::min<int64_t>(clip.y1, floorDiv(max_y - SUB/2, SUB));
+    if (x0 > x1 || y0 > y1) return {};
+
+    // vertices relative to the first cell center
+    int32_t lx[3], ly[3];
+    for (int i = 0; i < 3; ++i) {
+        lx[i] = (int32_t)(fx[i] - ((int64_t)x0 * SUB + SUB/2));
+        ly[i] = (int32_t)(fy[i] - ((int64_t)y0 * SUB + SUB/2));
+    }
+
+    // edge functions, positive inside; edges that are not top-left lose their boundary
+    int32_t step_x[3], step_y[3], row[3];
+    for (int e = 0; e < 3; ++e) {
+        int a = e, b = (e + 1) % 3;
+        int32_t A = ly[b] - ly[a];
+        int32_t B = lx[a] - lx[b];
+        bool top_left = A > 0 || (A == 0 && B > 0);
+
+        row[e] = -(A * lx[a] + B * ly[a]) - (top_left ? 0 : 1);
+        step_x[e] = A * SUB;
+        step_y[e] = B * SUB;
+    }
+
+    // depth plane stepped per cell; nearly edge-on triangles get the scanline path's bound
+    // on the normal, so the steps stay finite
+    Vec3 n = (t.p2 - t.p1).cross(t.p3 - t.p1).normalize();
+    if (std::abs(n.z) < 0.0001f) n.z = std::copysign(0.0001f, n.z);
+    float dzdx = -n.x / n.z, dzdy = -n.y / n.z;
+    float z_step_x = dzdx * dx, z_step_y = dzdy * dy;
+    float z_row = t.p1.z + dzdx * ((x0 + 0.5f) * dx - t.p1.x) + dzdy * ((y0 + 0.5f) * dy - t.p1.y);
+
+    RasterStats stats;
+
+#if defined(__SSE2__)
+    __m128i quad_step[3];
+    for (int e = 0; e < 3; ++e) quad_step[e] = _mm_set1_epi32(4 * step_x[e]);
+    const __m128 lane_z = _mm_mul_ps(_mm_setr_ps(0, 1, 2, 3), _mm_set1_ps(z_step_x));
+#endif
+
+    for (int yy = y0; yy <= y1; ++yy) {
+        float* zline = &depth[yy * width];
+        char* gline = &glyphs[yy * width];
+        int16_t* mline = &materials[yy * width];
+        auto shade = [&](int x, float z) {
+            ++stats.tested;
+            if (depthPasses<F>(z, zline[x])) {
+                if constexpr (!(F & RASTER_DEPTH_EQUAL)) zline[x] = z;
+                if constexpr (!(F & RASTER_DEPTH_ONLY)) gline[x] = c;
+                if constexpr ((F & RASTER_COLOR) != 0) mline[x] = mat_idx;
+                ++stats.written;
+            }
+        };
+
+        int32_t w[3] = {row[0], row[1], row[2]};
+        float z = z_row;
+        int xx = x0;
+
+#if defined(__SSE2__)
+        // 4 cells per step: coverage from the sign bits of the three edge functions
+        __m128i vw[3];
+        for (int e = 0; e < 3; ++e) {
+            vw[e] = _mm_add_epi32(_mm_set1_epi32(w[e]),
+                                  _mm_setr_epi32(0, step_x[e], 2 * step_x[e], 3 * step_x[e]));
+        }
+        for (; xx + 3 <= x1; xx += 4) {
+            __m128i any = _mm_or_si128(_mm_or_si128(vw[0], vw[1]), vw[2]);
+            int outside = _mm_movemask_ps(_mm_castsi128_ps(any));
+
+            if (outside != 0xF) {
+                // depth test on the depth plane alone; glyphs and materials only for the winners
+                __m128 vz = _mm_add_ps(_mm_set1_ps(z), lane_z);
+                __m128 old_z = _mm_loadu_ps(zline + xx);
+                __m128 outside_mask = _mm_castsi128_ps(_mm_srai_epi32(any, 31));
+                __m128 closer = (F & RASTER_DEPTH_EQUAL) ? _mm_cmple_ps(vz, old_z) : _mm_cmplt_ps(vz, old_z);
+                __m128 pass = _mm_andnot_ps(outside_mask, closer);
+                int written = _mm_movemask_ps(pass);
+
+                stats.tested += 4 - __builtin_popcount(outside);
+                if (written) {
+                    if constexpr (!(F & RASTER_DEPTH_EQUAL)) {
+                        _mm_storeu_ps(zline + xx, _mm_or_ps(_mm_and_ps(pass, vz), _mm_andnot_ps(pass, old_z)));
+                    }
+                    stats.written += __builtin_popcount(written);
+                    if constexpr (!(F & RASTER_DEPTH_ONLY)) {
+                        for (int k = 0; k < 4; ++k) {
+                            if (written & (1 << k)) {
+                                gline[xx + k] = c;
+                                if constexpr ((F & RASTER_COLOR) != 0) mline[xx + k] = mat_idx;
+                            }
+                        }
+                    }
+                }
+            }
+
+            for (int e = 0; e < 3; ++e) {
+                vw[e] = _mm_add_epi32(vw[e], quad_step[e]);
+                w[e] += 4 * step_x[e];
+            }
+            z += 4 * z_step_x;
+        }
+#endif
+
+        for (; xx <= x1; ++xx) {
+            if ((w[0] | w[1] | w[2]) >= 0) shade(xx, z);
+            for (int e = 0; e < 3; ++e) w[e] += step_x[e];
+            z += z_step_x;
+        }
+
+        for (int e = 0; e < 3; ++e) row[e] += step_y[e];
+        z_row += z_step_y;
+    }
+    if (stats.written) markDirty({x0, y0, x1, y1});
+    return stats;
+}
+
+void Surface::drawText(int x, int y, const std::string& text) {
+    if (y < 0 || y >= height) return;
+    for (size_t i = 0; i < text.size(); ++i) {
+        int xx = x + (int)i;
+        if (xx < 0 || xx >= width) continue;
+        depth[y * width + xx] = -std::numeric_limits<float>::infinity();
+        glyphs[y * width + xx] = text[i];
+        materials[y * width + xx] = -1;
+    }
+    if (width > 0) markDirty({std::clamp(x, 0, width - 1), y, std::clamp(x + (int)text.size() - 1, 0, width - 1), y});
+}
+
+template <unsigned F>
+void Surface::resolve(const Surface& samples, int sx, int sy, const std::string& chars) {
+    int sw = samples.width;
+    resolve_sum.resize(sw);
+    resolve_count.resize(sw);
+    resolve_cell_sum.resize(width);
+    resolve_cell_count.resize(width);
+    // mean luminance of n covered samples summing to s is (s - n) / (254 * n)
+    int n_max = sx * sy;
+    int last = (int)chars.size() - 1;
+    float scale = last / 254.0f;
+    std::string lut = chars + ' ';
+
     for (int y = 0; y < height; ++y) {
+        uint16_t* sum = resolve_sum.data();
+        uint16_t* count = resolve_count.data();
+        std::fill(resolve_sum.begin(), resolve_sum.end(), 0);
+        std::fill(resolve_count.begin(), resolve_count.end(), 0);
+
+        // vertical pass over the sy sample rows of this cell row: per-column luminance
+        // sums and covered counts, widened to 16 bits
+        for (int r = 0; r < sy; ++r) {
+            const uint8_t* src = reinterpret_cast<const uint8_t*>(samples.glyphRow(y * sy + r));
+            int x = 0;
+#if defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi8(1);
+            for (; x + 16 <= sw; x += 16) {
+                __m128i lum = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+                __m128i hit = _mm_min_epu8(lum, one);
+                __m128i* s = reinterpret_cast<__m128i*>(sum + x);
+                __m128i* n = reinterpret_cast<__m128i*>(count + x);
+                _mm_storeu_si128(s, _mm_add_epi16(_mm_loadu_si128(s), _mm_unpacklo_epi8(lum, zero)));
+                _mm_storeu_si128(s + 1, _mm_add_epi16(_mm_loadu_si128(s + 1), _mm_unpackhi_epi8(lum, zero)));
+                _mm_storeu_si128(n, _mm_add_epi16(_mm_loadu_si128(n), _mm_unpacklo_epi8(hit, zero)));
+                _mm_storeu_si128(n + 1, _mm_add_epi16(_mm_loadu_si128(n + 1), _mm_unpackhi_epi8(hit, zero)));
+            }
+#endif
+            for (; x < sw; ++x) {
+                sum[x] += src[x];
+                count[x] += src[x] != 0;
+            }
+        }
+
+        // horizontal pass: fold sx columns per cell, then glyph indices for the whole row
+        // in straight-line loops the compiler vectorizes
+        int32_t* cell_sum = resolve_cell_sum.data();
+        int32_t* cell_count = resolve_cell_count.data();
+        switch (sx) {
+            case 1: foldColumns<1>(sum, count, width, cell_sum, cell_count); break;
+            case 2: foldColumns<2>(sum, count, width, cell_sum, cell_count); break;
+            case 3: foldColumns<3>(sum, count, width, cell_sum, cell_count); break;
+            case 4: foldColumns<4>(sum, count, width, cell_sum, cell_count); break;
+            default: foldColumns(sum, count, width, sx, cell_sum, cell_count); break;
+        }
+        // glyph index per cell, overwriting the sums; lut[last + 1] is the blank glyph for
+        // cells less than half covered
+        int x = 0;
+#if defined(__SSE2__)
+        const __m128 v_scale = _mm_set1_ps(scale), v_half = _mm_set1_ps(0.5f);
+        const __m128 v_one = _mm_set1_ps(1.0f), v_last = _mm_set1_ps(last);
+        const __m128i v_blank = _mm_set1_epi32(last + 1), v_need = _mm_set1_epi32(n_max);
+        for (; x + 4 <= width; x += 4) {
+            __m128i vs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cell_sum + x));
+            __m128i vn = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cell_count + x));
+            __m128 mean = _mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(vs, vn)), v_scale),
+                                     _mm_max_ps(_mm_cvtepi32_ps(vn), v_one));
+            __m128i idx = _mm_cvttps_epi32(_mm_min_ps(_mm_add_ps(mean, v_half), v_last));
+            __m128i blank = _mm_cmplt_epi32(_mm_add_epi32(vn, vn), v_need);
+            idx = _mm_or_si128(_mm_and_si128(blank, v_blank), _mm_andnot_si128(blank, idx));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(cell_sum + x), idx);
+        }
+#endif
+        for (; x < width; ++x) {
+            int s = cell_sum[x], n = cell_count[x];
+            int idx = std::min((int)((s - n) * scale / std::max(n, 1) + 0.5f), last);
+            cell_sum[x] = 2 * n >= n_max ? idx : last + 1;
+        }
+
+        // a covered cell takes material and depth from its center sample, or from its nearest
+        // covered sample when the center missed, so colored silhouettes keep their edge cells
+        int cy = y * sy + sy / 2;
+        const char* center = samples.glyphRow(cy) + sx / 2;
+        float* zline = &depth[y * width];
+        char* gline = &glyphs[y * width];
+        int16_t* mline = &materials[y * width];
         for (int x = 0; x < width; ++x) {
-            const auto& p = pixels[y * width + x];
-            if (color_support && p.material != -1) {
-                // ANSI color approximation
-                std::cout << "\x1b[38;5;" << (p.material % 200 + 1) << "m" << p.c << "\x1b[0m";
-            } else {
-                std::cout << p.c;
+            bool covered = cell_sum[x] <= last;
+            gline[x] = lut[cell_sum[x]];
+            if (!covered) {
+                if constexpr ((F & RASTER_COLOR) != 0) mline[x] = -1;
+                zline[x] = std::numeric_limits<float>::infinity();
+                continue;
+            }
+
+            int px = x * sx + sx / 2, py = cy;
+            if (center[x * sx] == 0) {
+                float nearest = std::numeric_limits<float>::infinity();
+                for (int r = y * sy; r < (y + 1) * sy; ++r) {
+                    const char* g = samples.glyphRow(r);
+                    const float* z = samples.depthRow(r);
+                    for (int c = x * sx; c < (x + 1) * sx; ++c) {
+                        if (g[c] != 0 && z[c] <= nearest) {
+                            nearest = z[c];
+                            px = c;
+                            py = r;
+                        }
+                    }
+                }
             }
+            if constexpr ((F & RASTER_COLOR) != 0) mline[x] = samples.materialRow(py)[px];
+            zline[x] = std::min(samples.depthRow(py)[px], std::numeric_limits<float>::max());
         }
-        std::cout << "\n";
     }
+    std::fill(hiz_dirty.begin(), hiz_dirty.end(), 1);
 }
 
-void Surface::printNCurses(bool color_support) const {
+void Surface::upscale(const Surface& low) {
     for (int y = 0; y < height; ++y) {
-        move(y, 0);
+        int ly = y * low.height / height;
+        const float* zsrc = low.depthRow(ly);
+        const char* gsrc = low.glyphRow(ly);
+        const int16_t* msrc = low.materialRow(ly);
+        float* zline = &depth[y * width];
+        char* gline = &glyphs[y * width];
+        int16_t* mline = &materials[y * width];
         for (int x = 0; x < width; ++x) {
-            const auto& p = pixels[y * width + x];
-            if (color_support && p.material != -1) {
-                int col = p.material + 1;
-                attron(COLOR_PAIR(col));
-                printw("%c", p.c);
-                attroff(COLOR_PAIR(col));
-            } else {
-                printw("%c", p.c);
-            }
+            int lx = x * low.width / width;
+            zline[x] = zsrc[lx];
+            gline[x] = gsrc[lx];
+            mline[x] = msrc[lx];
         }
     }
-}
\ No newline at end of file
+    std::fill(hiz_dirty.begin(), hiz_dirty.end(), 1);
+}
+
+size_t Surface::coveredCount() const {
+    return std::count_if(depth.begin(), depth.end(), [](float z) {
+        return z != std::numeric_limits<float>::infinity();
+    });
+}
+
+// the raster variants the renderer picks from
+template RasterStats Surface::drawTriangle<0>(const Triangle&, char, int);
+template RasterStats Surface::drawTriangle<0>(const Triangle&, char, int, const Rect&);
+template RasterStats Surface::drawTriangle<RASTER_COLOR>(const Triangle&, char, int);
+template RasterStats Surface::drawTriangle<RASTER_COLOR>(const Triangle&, char, int, const Rect&);
+template RasterStats Surface::drawTriangle<RASTER_DEPTH_ONLY>(const Triangle&, char, int);
+template RasterStats Surface::drawTriangle<RASTER_DEPTH_ONLY>(const Triangle&, char, int, const Rect&);
+template RasterStats Surface::drawTriangle<RASTER_DEPTH_EQUAL>(const Triangle&, char, int);
+template RasterStats Surface::drawTriangle<RASTER_DEPTH_EQUAL>(const Triangle&, char, int, const Rect&);
+template RasterStats Surface::drawTriangle<RASTER_DEPTH_EQUAL | RASTER_COLOR>(const Triangle&, char, int);
+template RasterStats Surface::drawTriangle<RASTER_DEPTH_EQUAL | RASTER_COLOR>(const Triangle&, char, int, const Rect&);
+template void Surface::resolve<0>(const Surface&, int, int, const std::string&);
+template void Surface::resolve<RASTER_COLOR>(const Surface&, int, int, const std::string&);
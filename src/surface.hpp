@@ -3,32 +3,117 @@
 #include <vector>
 #include <string>
 #include <limits>
-
-struct Pixel {
-    float z = std::numeric_limits<float>::infinity();
-    char c = ' ';
-    int material = -1;
-};
+#include <cstdint>
 
 struct Triangle {
     Vec3 p1, p2, p3;
 };
 
+enum class RasterMode {
+    Scanline,
+    HalfSpace
+};
+
+// what a raster variant writes, as compile-time flags so the per-cell loops carry no dead
+// stores or flag checks
+enum RasterFeature : unsigned {
+    RASTER_COLOR = 1,        // material plane, read only by color output
+    RASTER_DEPTH_ONLY = 2,   // depth prepass: depth plane alone
+    RASTER_DEPTH_EQUAL = 4,  // shading after a prepass: passes the stored depth, never writes it
+};
+
+// per-triangle pixel counters, summed per frame
+struct RasterStats {
+    uint64_t tested = 0;   // depth tests performed
+    uint64_t written = 0;  // depth tests passed
+    uint64_t culled = 0;   // back-facing triangles rejected
+    uint64_t occluded = 0; // triangles rejected by the hierarchical depth test
+
+    RasterStats& operator+=(const RasterStats& o) {
+        tested += o.tested;
+        written += o.written;
+        culled += o.culled;
+        occluded += o.occluded;
+        return *this;
+    }
+};
+
+// inclusive cell rectangle
+struct Rect {
+    int x0, y0, x1, y1;
+};
+
 class Surface {
     int width, height;
     float logical_w, logical_h;
     float dx, dy;
-    std::vector<Pixel> pixels;
+    // framebuffer planes: depth is all the depth test reads, glyph and material all the presenters read
+    std::vector<float> depth;
+    std::vector<char> glyphs;
+    std::vector<int16_t> materials;
+    // per-column sums reused by resolve()
+    std::vector<uint16_t> resolve_sum, resolve_count;
+    std::vector<int32_t> resolve_cell_sum, resolve_cell_count;
+    RasterMode mode = RasterMode::Scanline;
+    // farthest depth per HIZ_W x HIZ_H block, refreshed lazily after writes
+    int hiz_w, hiz_h;
+    std::vector<float> hiz_max;
+    std::vector<uint8_t> hiz_dirty;
 
 public:
+    // hierarchical depth block size; divides the TileRasterizer tiles so workers never share a block
+    static constexpr int HIZ_W = 8;
+    static constexpr int HIZ_H = 4;
+    // largest index the material plane holds; triangles with higher ones are drawn uncolored
+    static constexpr int MAX_MATERIAL = INT16_MAX;
+
     Surface(int w, int h, float lw, float lh);
     
-    void clear();
-    void drawTriangle(const Triangle& tri, char c, int mat_idx);
-    void print(bool color_support) const;
-    void printNCurses(bool color_support) const;
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    float getLogicalWidth() const { return logical_w; }
+    float getLogicalHeight() const { return logical_h; }
+    Rect fullRect() const { return {0, 0, width - 1, height - 1}; }
+    const float* depthRow(int y) const { return &depth[y * width]; }
+    const char* glyphRow(int y) const { return &glyphs[y * width]; }
+    // material index per cell, -1 for none
+    const int16_t* materialRow(int y) const { return &materials[y * width]; }
+    void setRasterMode(RasterMode m) { mode = m; }
+
+    // background glyph 0 marks uncovered samples on supersampled surfaces; the material
+    // plane is left alone without RASTER_COLOR
+    void clear(char background = ' ', unsigned features = RASTER_COLOR);
+    static bool backfacing(const Triangle& tri);
+    Rect bounds(const Triangle& tri) const;
+    // cells covering the logical box [lo, hi], clamped to the surface
+    Rect bounds(const Vec3& lo, const Vec3& hi) const;
+    // true when nothing at depth >= min_z inside r can pass the depth test; after a depth
+    // prepass (ties_pass) only what lies strictly behind is hidden
+    bool occluded(const Rect& r, float min_z, bool ties_pass = false);
+    // instantiated for the RasterFeature sets listed in surface.cpp
+    template <unsigned F>
+    RasterStats drawTriangle(const Triangle& tri, char c, int mat_idx);
+    template <unsigned F>
+    RasterStats drawTriangle(const Triangle& tri, char c, int mat_idx, const Rect& clip);
+    // text drawn in front of everything else (HUD overlays)
+    void drawText(int x, int y, const std::string& text);
+    // box-filters an sx x sy sample surface (glyphs holding luminance 1..255, 0 = empty) into
+    // this surface's cells; half-covered cells get the glyph for their mean luminance
+    template <unsigned F>
+    void resolve(const Surface& samples, int sx, int sy, const std::string& chars);
+    // fills every cell from the nearest cell of a lower-resolution surface of the same
+    // logical size (adaptive resolution)
+    void upscale(const Surface& low);
+    // cells touched by at least one triangle
+    size_t coveredCount() const;
 
 private:
     int idxX(float x) const;
     int idxY(float y) const;
+    void markDirty(const Rect& r);
+    void refreshBlock(int bx, int by);
+    template <unsigned F>
+    RasterStats drawScanline(const Triangle& tri, char c, int mat_idx, const Rect& clip);
+    template <unsigned F>
+    RasterStats drawHalfSpace(const Triangle& tri, char c, int mat_idx, const Rect& clip);
 };
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "terminal.hpp"
+#include <ncurses.h>
+#include <csignal>
+#include <cstring>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+    const char ENTER[] = "\x1b[?1049h\x1b[?25l";
+    const char LEAVE[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+
+    termios saved_mode;
+    struct sigaction saved_winch, saved_int, saved_term;
+    volatile sig_atomic_t resized = 0;
+
+    void restore() {
+        [[maybe_unused]] ssize_t n = write(STDOUT_FILENO, LEAVE, sizeof(LEAVE) - 1);
+        tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved_mode);
+    }
+
+    void onResize(int) {
+        resized = 1;
+    }
+
+    // ^C and kill leave a usable shell behind, as ncurses does
+    void onExit(int sig) {
+        restore();
+        std::signal(sig, SIG_DFL);
+        std::raise(sig);
+    }
+}
+
+RawTerminal::RawTerminal() {
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) || tcgetattr(STDIN_FILENO, &saved_mode) != 0) return;
+
+    // no echo, no line buffering, reads return at once; signals still come from the keyboard
+    termios raw = saved_mode;
+    raw.c_iflag &= ~(ICRNL | IXON);
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0) return;
+
+    // no SA_RESTART, so a resize also wakes a poll() waiting for keys
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = onResize;
+    sigaction(SIGWINCH, &sa, &saved_winch);
+    sa.sa_handler = onExit;
+    sigaction(SIGINT, &sa, &saved_int);
+    sigaction(SIGTERM, &sa, &saved_term);
+
+    [[maybe_unused]] ssize_t n = write(STDOUT_FILENO, ENTER, sizeof(ENTER) - 1);
+    open = true;
+}
+
+RawTerminal::~RawTerminal() {
+    if (!open) return;
+    sigaction(SIGWINCH, &saved_winch, nullptr);
+    sigaction(SIGINT, &saved_int, nullptr);
+    sigaction(SIGTERM, &saved_term, nullptr);
+    restore();
+}
+
+bool RawTerminal::size(int& w, int& h) const {
+    winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != 0 || ws.ws_col == 0 || ws.ws_row == 0) return false;
+    w = ws.ws_col;
+    h = ws.ws_row;
+    return true;
+}
+
+int RawTerminal::readKey() {
+    if (resized) {
+        resized = 0;
+        return KEY_RESIZE;
+    }
+    if (pending_len == 0) {
+        ssize_t n = read(STDIN_FILENO, pending, sizeof(pending));
+        if (n <= 0) return ERR;
+        pending_len = (int)n;
+    }
+
+    auto consume = [&](int n) {
+        pending_len -= n;
+        std::memmove(pending, pending + n, pending_len);
+    };
+
+    // arrows arrive as ESC [ A..D, or ESC O A..D in application cursor mode
+    if (pending[0] == '\x1b' && pending_len >= 3 && (pending[1] == '[' || pending[1] == 'O')) {
+        int key = ERR;
+        switch (pending[2]) {
+            case 'A': key = KEY_UP; break;
+            case 'B': key = KEY_DOWN; break;
+            case 'C': key = KEY_RIGHT; break;
+            case 'D': key = KEY_LEFT; break;
+        }
+        if (key != ERR) {
+            consume(3);
+            return key;
+        }
+        // skip any other control sequence up to its final byte
+        int end = 2;
+        while (end < pending_len && (pending[end] < 0x40 || pending[end] > 0x7e)) ++end;
+        consume(end < pending_len ? end + 1 : pending_len);
+        return readKey();
+    }
+
+    int key = (unsigned char)pending[0];
+    consume(1);
+    return key;
+}
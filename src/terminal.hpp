@@ -0,0 +1,26 @@
+#pragma once
+
+// the controlling terminal set up for AnsiPresenter: raw unechoed input on the alternate
+// screen with the cursor hidden, all undone on destruction. keys come back as the ncurses
+// codes getch() uses, so the viewer handles both backends alike
+class RawTerminal {
+public:
+    RawTerminal();
+    ~RawTerminal();
+
+    RawTerminal(const RawTerminal&) = delete;
+    RawTerminal& operator=(const RawTerminal&) = delete;
+
+    // false when stdin/stdout is not a terminal
+    bool isOpen() const { return open; }
+    // size in cells, false when unknown
+    bool size(int& w, int& h) const;
+    // next key without blocking: a character, KEY_LEFT/RIGHT/UP/DOWN for arrows,
+    // KEY_RESIZE after the window changed size, or ERR when nothing is waiting
+    int readKey();
+
+private:
+    bool open = false;
+    char pending[64];
+    int pending_len = 0;
+};
@@ -0,0 +1,73 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads)
+    : count(std::max(threads, 1)), queues(new Queue[count]) {
+    for (int i = 1; i < count; ++i) {
+        this->threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+        ++generation;
+    }
+    cv_start.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+void ThreadPool::run(int jobs, const std::function<void(int, int)>& job) {
+    if (jobs <= 0) return;
+    if (count == 1) {
+        for (int i = 0; i < jobs; ++i) job(0, i);
+        return;
+    }
+
+    current = &job;
+    for (int w = 0; w < count; ++w) {
+        queues[w].next.store((int)((long long)jobs * w / count), std::memory_order_relaxed);
+        queues[w].end = (int)((long long)jobs * (w + 1) / count);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        pending = count - 1;
+        ++generation;
+    }
+    cv_start.notify_all();
+
+    drain(0);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    cv_done.wait(lock, [&]{ return pending == 0; });
+    current = nullptr;
+}
+
+void ThreadPool::workerLoop(int id) {
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        cv_start.wait(lock, [&]{ return generation != seen; });
+        seen = generation;
+        if (stopping) return;
+
+        lock.unlock();
+        drain(id);
+        lock.lock();
+
+        if (--pending == 0) cv_done.notify_one();
+    }
+}
+
+void ThreadPool::drain(int id) {
+    // own range first, then steal from the others
+    for (int k = 0; k < count; ++k) {
+        Queue& q = queues[(id + k) % count];
+        int i;
+        while ((i = q.next.fetch_add(1, std::memory_order_relaxed)) < q.end) {
+            (*current)(id, i);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed pool of workers; the calling thread takes part as worker 0
+class ThreadPool {
+public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return count; }
+
+    // runs job(worker, i) for every i in [0, jobs) and blocks until all are done.
+    // jobs are split into one contiguous range per worker; idle workers steal from the others
+    void run(int jobs, const std::function<void(int, int)>& job);
+
+private:
+    struct alignas(64) Queue {
+        std::atomic<int> next{0};
+        int end = 0;
+    };
+
+    void workerLoop(int id);
+    void drain(int id);
+
+    int count;
+    std::unique_ptr<Queue[]> queues;
+    std::vector<std::thread> threads;
+    const std::function<void(int, int)>* current = nullptr;
+
+    std::mutex mtx;
+    std::condition_variable cv_start, cv_done;
+    unsigned generation = 0;
+    int pending = 0;
+    bool stopping = false;
+};
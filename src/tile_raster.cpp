@@ -0,0 +1,111 @@
+#include "tile_raster.hpp"
+#include <algorithm>
+
+TileRasterizer::TileRasterizer(int threads) : pool(threads), worker_stats(pool.size()) {}
+
+void TileRasterizer::begin(Surface& surf) {
+    surface = &surf;
+    std::fill(worker_stats.begin(), worker_stats.end(), WorkerStats{});
+    if (pool.size() == 1) return;
+
+    tiles_x = (surf.getWidth() + TILE_W - 1) / TILE_W;
+    tiles_y = (surf.getHeight() + TILE_H - 1) / TILE_H;
+    bins.resize(tiles_x * tiles_y);
+    for (auto& bin : bins) bin.clear();
+    cmds.clear();
+    groups.clear();
+    group = NO_GROUP;
+}
+
+template <unsigned F>
+bool TileRasterizer::beginGroup(const Rect& rect, float near_z) {
+    if (pool.size() == 1) return !surface->occluded(rect, near_z, F & RASTER_DEPTH_EQUAL);
+    group = groups.size();
+    groups.push_back({rect, near_z});
+    return true;
+}
+
+template <unsigned F>
+void TileRasterizer::submit(const Triangle& tri, char c, int mat_idx) {
+    // single thread: no point in binning
+    if (pool.size() == 1) {
+        worker_stats[0].stats += surface->drawTriangle<F>(tri, c, mat_idx);
+        return;
+    }
+    if (Surface::backfacing(tri)) {
+        ++worker_stats[0].stats.culled;
+        return;
+    }
+
+    uint32_t id = cmds.size();
+    cmds.push_back({tri, c, mat_idx, group});
+
+    Rect r = surface->bounds(tri);
+    for (int ty = r.y0 / TILE_H; ty <= r.y1 / TILE_H; ++ty) {
+        for (int tx = r.x0 / TILE_W; tx <= r.x1 / TILE_W; ++tx) {
+            bins[ty * tiles_x + tx].push_back(id);
+        }
+    }
+}
+
+template <unsigned F>
+RasterStats TileRasterizer::flush() {
+    pool.run(pool.size() == 1 ? 0 : tiles_x * tiles_y, [&](int worker, int tile) {
+        const auto& bin = bins[tile];
+        if (bin.empty()) return;
+
+        int tx = tile % tiles_x, ty = tile / tiles_x;
+        Rect clip = {
+            tx * TILE_W,
+            ty * TILE_H,
+            std::min((tx + 1) * TILE_W, surface->getWidth()) - 1,
+            std::min((ty + 1) * TILE_H, surface->getHeight()) - 1
+        };
+
+        // bins hold triangles in submission order, so results match the serial path, and the
+        // triangles of a group are adjacent: its part of the tile is tested once, against the
+        // depth of everything drawn here before it
+        RasterStats stats;
+        uint32_t last_group = NO_GROUP;
+        bool hidden = false;
+        for (uint32_t id : bin) {
+            const DrawCmd& cmd = cmds[id];
+            if (cmd.group != last_group) {
+                last_group = cmd.group;
+                hidden = false;
+                if (cmd.group != NO_GROUP) {
+                    const Group& g = groups[cmd.group];
+                    Rect r = {std::max(g.rect.x0, clip.x0), std::max(g.rect.y0, clip.y0),
+                              std::min(g.rect.x1, clip.x1), std::min(g.rect.y1, clip.y1)};
+                    hidden = r.x0 <= r.x1 && r.y0 <= r.y1 && surface->occluded(r, g.near_z, F & RASTER_DEPTH_EQUAL);
+                }
+            }
+            if (hidden) {
+                ++stats.occluded;
+                continue;
+            }
+            stats += surface->drawTriangle<F>(cmd.tri, cmd.c, cmd.material, clip);
+        }
+        worker_stats[worker].stats += stats;
+    });
+
+    RasterStats total;
+    for (const auto& w : worker_stats) total += w.stats;
+    return total;
+}
+
+template bool TileRasterizer::beginGroup<0>(const Rect&, float);
+template bool TileRasterizer::beginGroup<RASTER_COLOR>(const Rect&, float);
+template bool TileRasterizer::beginGroup<RASTER_DEPTH_ONLY>(const Rect&, float);
+template bool TileRasterizer::beginGroup<RASTER_DEPTH_EQUAL>(const Rect&, float);
+template bool TileRasterizer::beginGroup<RASTER_DEPTH_EQUAL | RASTER_COLOR>(const Rect&, float);
+template void TileRasterizer::submit<0>(const Triangle&, char, int);
+template void TileRasterizer::submit<RASTER_COLOR>(const Triangle&, char, int);
+template void TileRasterizer::submit<RASTER_DEPTH_ONLY>(const Triangle&, char, int);
+template void TileRasterizer::submit<RASTER_DEPTH_EQUAL>(const Triangle&, char, int);
+template void TileRasterizer::submit<RASTER_DEPTH_EQUAL | RASTER_COLOR>(const Triangle&, char, int);
+template RasterStats TileRasterizer::flush<0>();
+template RasterStats TileRasterizer::flush<RASTER_COLOR>();
+template RasterStats TileRasterizer::flush<RASTER_DEPTH_ONLY>();
+template RasterStats TileRasterizer::flush<RASTER_DEPTH_EQUAL>();
+template RasterStats TileRasterizer::flush<RASTER_DEPTH_EQUAL | RASTER_COLOR>();
@@ -0,0 +1,58 @@
+#pragma once
+#include "surface.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <vector>
+
+// bins triangles into screen tiles and rasterizes the tiles in parallel.
+// every tile is owned by one worker at a time, so depth tests need no locking
+class TileRasterizer {
+public:
+    static constexpr int TILE_W = 32;
+    static constexpr int TILE_H = 8;
+    static_assert(TILE_W % Surface::HIZ_W == 0 && TILE_H % Surface::HIZ_H == 0,
+                  "hierarchical depth blocks must not straddle tiles");
+
+    explicit TileRasterizer(int threads);
+
+    int threadCount() const { return pool.size(); }
+
+    void begin(Surface& surf);
+    // starts a group of triangles (a meshlet) lying inside rect no nearer than near_z, and
+    // returns false when the whole group is hidden. serial passes test the depth buffer now;
+    // binned passes only fill it in flush, so each tile tests the group there before drawing it
+    template <unsigned F>
+    bool beginGroup(const Rect& rect, float near_z);
+    // F is the Surface raster variant; every submit of a pass and its flush use the same one
+    template <unsigned F>
+    void submit(const Triangle& tri, char c, int mat_idx);
+    // finishes the pass and returns its pixel counters
+    template <unsigned F>
+    RasterStats flush();
+
+private:
+    struct DrawCmd {
+        Triangle tri;
+        char c;
+        int material;
+        uint32_t group;
+    };
+    struct Group {
+        Rect rect;
+        float near_z;
+    };
+    static constexpr uint32_t NO_GROUP = UINT32_MAX;
+    // one cache line per worker, so tiles finishing on different workers don't false-share
+    struct alignas(64) WorkerStats {
+        RasterStats stats;
+    };
+
+    ThreadPool pool;
+    Surface* surface = nullptr;
+    int tiles_x = 0, tiles_y = 0;
+    std::vector<DrawCmd> cmds;
+    std::vector<Group> groups;
+    uint32_t group = NO_GROUP;
+    std::vector<std::vector<uint32_t>> bins;
+    std::vector<WorkerStats> worker_stats;
+};
@@ -0,0 +1,215 @@
+#include "triangulate.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void Triangulator::triangulate(const std::vector<Vec3>& pts, std::vector<int>& tris) {
+    int n = pts.size();
+    if (n < 3) return;
+    points = &pts;
+
+    // winding from the shoelace sum
+    double area = 0;
+    for (int i = 0, j = n - 1; i < n; j = i++) area += (double)pts[j].x * pts[i].y - (double)pts[i].x * pts[j].y;
+    orient = area >= 0 ? 1.0f : -1.0f;
+
+    // triangles and convex polygons (most quads) are fans
+    if (n == 3 || isConvexPolygon()) {
+        for (int i = 1; i + 1 < n; ++i) tris.insert(tris.end(), {0, i, i + 1});
+        return;
+    }
+
+    prev.resize(n);
+    next.resize(n);
+    reflex.resize(n);
+    for (int i = 0; i < n; ++i) {
+        prev[i] = (i + n - 1) % n;
+        next[i] = (i + 1) % n;
+    }
+    // collinear vertices count as reflex too, they can sit on an ear's edge
+    for (int i = 0; i < n; ++i) reflex[i] = turn(prev[i], i, next[i]) <= 0;
+    buildGrid(0);
+
+    int remaining = n;
+    int ear = 0, stop = ear;
+    while (remaining > 3) {
+        int a = prev[ear], c = next[ear];
+
+        // clip when it is an ear; after a full lap without one the polygon is not simple
+        // (or numerically degenerate), so clip anyway to guarantee progress
+        bool clip = isEar(ear) || c == stop;
+        if (!clip) {
+            ear = c;
+            continue;
+        }
+
+        tris.insert(tris.end(), {a, ear, c});
+        next[a] = c;
+        prev[c] = a;
+        live_reflex -= reflex[ear];
+        reflex[ear] = 0;
+        --remaining;
+
+        // removing an ear only shrinks its neighbours' interior angles
+        if (reflex[a] && turn(prev[a], a, c) > 0) {
+            reflex[a] = 0;
+            --live_reflex;
+        }
+        if (reflex[c] && turn(a, c, next[c]) > 0) {
+            reflex[c] = 0;
+            --live_reflex;
+        }
+        // drop dead grid entries once they outnumber the live ones
+        if (live_reflex * 2 < (int)cell_items.size()) buildGrid(c);
+
+        ear = next[c];
+        stop = ear;
+    }
+    tris.insert(tris.end(), {prev[ear], ear, next[ear]});
+}
+
+bool Triangulator::isConvexPolygon() const {
+    const std::vector<Vec3>& p = *points;
+    int n = p.size();
+
+    // every turn on the same side and the edge directions sweeping around once
+    // (a pentagram turns one way throughout but its x direction flips four times)
+    int x_flips = 0, y_flips = 0;
+    float last_dx = 0, last_dy = 0;
+    for (int i = 0; i < n; ++i) {
+        if (turn((i + n - 1) % n, i, (i + 1) % n) < 0) return false;
+
+        const Vec3& a = p[i];
+        const Vec3& b = p[(i + 1) % n];
+        float dx = b.x - a.x, dy = b.y - a.y;
+        if (dx != 0) {
+            if (last_dx != 0 && (dx > 0) != (last_dx > 0)) ++x_flips;
+            last_dx = dx;
+        }
+        if (dy != 0) {
+            if (last_dy != 0 && (dy > 0) != (last_dy > 0)) ++y_flips;
+            last_dy = dy;
+        }
+    }
+    return x_flips <= 2 && y_flips <= 2;
+}
+
+float Triangulator::turn(int a, int b, int c) const {
+    const std::vector<Vec3>& p = *points;
+    return orient * ((p[b].x - p[a].x) * (p[c].y - p[b].y) - (p[b].y - p[a].y) * (p[c].x - p[b].x));
+}
+
+bool Triangulator::isEar(int b) const {
+    int a = prev[b], c = next[b];
+    if (turn(a, b, c) < 0) return false;
+
+    const std::vector<Vec3>& p = *points;
+    const Vec3 &pa = p[a], &pb = p[b], &pc = p[c];
+    int x0, y0, x1, y1;
+    cellOf({std::min({pa.x, pb.x, pc.x}), std::min({pa.y, pb.y, pc.y}), 0}, x0, y0);
+    cellOf({std::max({pa.x, pb.x, pc.x}), std::max({pa.y, pb.y, pc.y}), 0}, x1, y1);
+
+    for (int cy = y0; cy <= y1; ++cy) {
+        // only the cells the triangle spans within this row; thin diagonal ears cover
+        // a small part of their bounding box
+        int row_x0 = x0, row_x1 = x1;
+        if (y0 != y1) {
+            float lo = min_y + (cy - 0.01f) / inv_cell_h, hi = min_y + (cy + 1.01f) / inv_cell_h;
+            float span_lo = std::numeric_limits<float>::infinity(), span_hi = -span_lo;
+            const Vec3* tri[3] = {&pa, &pb, &pc};
+            for (int e = 0; e < 3; ++e) {
+                const Vec3& u = *tri[e];
+                const Vec3& v = *tri[(e + 1) % 3];
+                float t0 = 0, t1 = 1;
+                if (u.y != v.y) {
+                    float ta = (lo - u.y) / (v.y - u.y), tb = (hi - u.y) / (v.y - u.y);
+                    t0 = std::max(t0, std::min(ta, tb));
+                    t1 = std::min(t1, std::max(ta, tb));
+                } else if (u.y < lo || u.y > hi) {
+                    continue;
+                }
+                if (t0 > t1) continue;
+                float xa = u.x + (v.x - u.x) * t0, xb = u.x + (v.x - u.x) * t1;
+                span_lo = std::min({span_lo, xa, xb});
+                span_hi = std::max({span_hi, xa, xb});
+            }
+            if (span_lo > span_hi) continue;
+            int unused;
+            cellOf({span_lo, lo, 0}, row_x0, unused);
+            cellOf({span_hi, lo, 0}, row_x1, unused);
+            // float slop at the slab borders: widen by a cell
+            row_x0 = std::max(row_x0 - 1, x0);
+            row_x1 = std::min(row_x1 + 1, x1);
+        }
+
+        for (int cx = row_x0; cx <= row_x1; ++cx) {
+            int cell = cy * grid_w + cx;
+            for (int k = cell_start[cell]; k < cell_start[cell + 1]; ++k) {
+                int v = cell_items[k];
+                if (!reflex[v] || v == a || v == b || v == c) continue;
+
+                // duplicated positions (e.g. bridged holes) do not block
+                const Vec3& q = p[v];
+                if ((q.x == pa.x && q.y == pa.y) || (q.x == pc.x && q.y == pc.y)) continue;
+
+                float d1 = orient * ((pb.x - pa.x) * (q.y - pa.y) - (pb.y - pa.y) * (q.x - pa.x));
+                float d2 = orient * ((pc.x - pb.x) * (q.y - pb.y) - (pc.y - pb.y) * (q.x - pb.x));
+                float d3 = orient * ((pa.x - pc.x) * (q.y - pc.y) - (pa.y - pc.y) * (q.x - pc.x));
+                if (d1 >= 0 && d2 >= 0 && d3 >= 0) return false;
+            }
+        }
+    }
+    return true;
+}
+
+void Triangulator::buildGrid(int start) {
+    const std::vector<Vec3>& p = *points;
+
+    // bounds of the vertices still linked
+    float max_x = p[start].x, max_y = p[start].y;
+    min_x = p[start].x;
+    min_y = p[start].y;
+    int reflex_count = 0;
+    int i = start;
+    do {
+        min_x = std::min(min_x, p[i].x);
+        min_y = std::min(min_y, p[i].y);
+        max_x = std::max(max_x, p[i].x);
+        max_y = std::max(max_y, p[i].y);
+        reflex_count += reflex[i];
+    } while ((i = next[i]) != start);
+
+    // about one reflex vertex per cell, with the cells roughly square
+    float w = std::max(max_x - min_x, 1e-20f), h = std::max(max_y - min_y, 1e-20f);
+    float cells = std::max(1, reflex_count);
+    grid_w = std::clamp((int)std::sqrt(cells * w / h), 1, (int)cells);
+    grid_h = std::clamp((int)(cells / grid_w), 1, (int)cells);
+    inv_cell_w = grid_w / w;
+    inv_cell_h = grid_h / h;
+
+    cell_start.assign(grid_w * grid_h + 1, 0);
+    i = start;
+    do {
+        if (!reflex[i]) continue;
+        int cx, cy;
+        cellOf(p[i], cx, cy);
+        ++cell_start[cy * grid_w + cx + 1];
+    } while ((i = next[i]) != start);
+    for (size_t i = 1; i < cell_start.size(); ++i) cell_start[i] += cell_start[i - 1];
+
+    cell_items.resize(reflex_count);
+    live_reflex = reflex_count;
+    cell_cursor.assign(cell_start.begin(), cell_start.end() - 1);
+    i = start;
+    do {
+        if (!reflex[i]) continue;
+        int cx, cy;
+        cellOf(p[i], cx, cy);
+        cell_items[cell_cursor[cy * grid_w + cx]++] = i;
+    } while ((i = next[i]) != start);
+}
+
+void Triangulator::cellOf(const Vec3& p, int& cx, int& cy) const {
+    cx = std::clamp((int)((p.x - min_x) * inv_cell_w), 0, grid_w - 1);
+    cy = std::clamp((int)((p.y - min_y) * inv_cell_h), 0, grid_h - 1);
+}
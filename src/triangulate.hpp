@@ -0,0 +1,33 @@
+#pragma once
+#include "vec3.hpp"
+#include <cstdint>
+#include <vector>
+
+// ear-clipping triangulator for simple polygons in the xy plane. only reflex vertices can
+// block an ear, so they are bucketed in a uniform grid and each ear test looks at the cells
+// under the candidate triangle. buffers are kept between calls; use one instance per thread
+class Triangulator {
+public:
+    // appends n - 2 triangles as indices into pts, wound like the polygon
+    void triangulate(const std::vector<Vec3>& pts, std::vector<int>& tris);
+
+private:
+    bool isConvexPolygon() const;
+    float turn(int a, int b, int c) const;
+    bool isEar(int b) const;
+    // buckets the reflex vertices of the loop through start
+    void buildGrid(int start);
+    void cellOf(const Vec3& p, int& cx, int& cy) const;
+
+    const std::vector<Vec3>* points = nullptr;
+    float orient = 1;  // +1 for counter-clockwise input, -1 for clockwise
+
+    std::vector<int> prev, next;
+    std::vector<uint8_t> reflex;
+
+    // reflex vertices by grid cell (CSR); entries that stop being reflex are skipped lazily
+    int grid_w = 0, grid_h = 0;
+    float min_x = 0, min_y = 0, inv_cell_w = 0, inv_cell_h = 0;
+    std::vector<int> cell_start, cell_items, cell_cursor;
+    int live_reflex = 0;
+};
@@ -12,6 +12,10 @@ struct Vec3 {
         return std::sqrt(x*x + y*y + z*z); 
     }
 
+    bool isFinite() const {
+        return std::isfinite(x) && std::isfinite(y) && std::isfinite(z);
+    }
+
     Vec3 normalize() const {
         float m = mag();
         return (m == 0) ? Vec3{} : Vec3{x/m, y/m, z/m};
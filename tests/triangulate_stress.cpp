@@ -0,0 +1,132 @@
+#include "triangulate.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// seeded randomized stress test of the triangulator on large simple polygons. every result
+// must have n - 2 triangles, indices in range, every triangle wound like the polygon, and
+// triangle areas that add up to the polygon area. exits non-zero if any polygon fails
+namespace {
+    constexpr float TWO_PI = 6.2831853f;
+    constexpr int MAX_VERTICES = 20000;
+
+    std::mt19937 rng(20261016);
+
+    float uniform(float lo, float hi) { return std::uniform_real_distribution<float>(lo, hi)(rng); }
+
+    // vertex count spread log-uniformly over [3, max], so small and huge polygons both show up
+    int randomCount(int max) { return (int)std::lround(std::exp(uniform(std::log(3.0f), std::log((float)max)))); }
+
+    // star-shaped around the origin: sorted jittered angles, random radii
+    std::vector<Vec3> randomStar(int n) {
+        std::vector<Vec3> pts;
+        for (int i = 0; i < n; ++i) {
+            float a = TWO_PI * (i + uniform(0.0f, 0.5f)) / n;
+            float r = uniform(0.05f, 1.0f);
+            pts.emplace_back(r * std::cos(a), r * std::sin(a), 0);
+        }
+        return pts;
+    }
+
+    // a band wound around the origin several times: out along the outer edge, back along the
+    // inner one. the band is narrower than the gap between turns, so the polygon stays simple
+    std::vector<Vec3> randomSpiral(int n) {
+        int half = std::max(n / 2, 2);
+        float turns = uniform(1.0f, std::min(20.0f, half / 64.0f + 1.0f));
+        float gap = 1.0f, width = gap * uniform(0.2f, 0.8f);
+        std::vector<Vec3> outer, inner;
+        for (int i = 0; i < half; ++i) {
+            float t = TWO_PI * turns * i / (half - 1);
+            float r = 1.0f + gap * t / TWO_PI;
+            outer.emplace_back((r + width) * std::cos(t), (r + width) * std::sin(t), 0);
+            inner.emplace_back(r * std::cos(t), r * std::sin(t), 0);
+        }
+        std::vector<Vec3> pts = outer;
+        pts.insert(pts.end(), inner.rbegin(), inner.rend());
+        return pts;
+    }
+
+    // a comb of teeth with random widths and heights: long reflex chains
+    std::vector<Vec3> randomComb(int teeth) {
+        std::vector<float> xs = {0};
+        for (int i = 0; i < teeth; ++i) xs.push_back(xs.back() + uniform(0.1f, 1.0f));
+        std::vector<Vec3> pts = {{0, 0, 0}, {xs.back(), 0, 0}};
+        for (int i = teeth - 1; i >= 0; --i) {
+            float mid = xs[i] + (xs[i + 1] - xs[i]) * uniform(0.2f, 0.8f);
+            float h = uniform(1.5f, 10.0f);
+            pts.emplace_back(xs[i + 1], h, 0);
+            pts.emplace_back(mid, h, 0);
+            pts.emplace_back(mid, 1, 0);
+            pts.emplace_back(xs[i], 1, 0);
+        }
+        return pts;
+    }
+
+    double signedArea(const Vec3& a, const Vec3& b, const Vec3& c) {
+        return 0.5 * (((double)b.x - a.x) * ((double)c.y - a.y) - ((double)c.x - a.x) * ((double)b.y - a.y));
+    }
+
+    bool check(const std::string& name, const std::vector<Vec3>& pts, bool reverse) {
+        std::vector<Vec3> poly = pts;
+        if (reverse) std::reverse(poly.begin(), poly.end());
+
+        Triangulator triangulator;
+        std::vector<int> tris;
+        triangulator.triangulate(poly, tris);
+
+        size_t n = poly.size();
+        auto fail = [&](const char* what) {
+            std::fprintf(stderr, "FAIL %s (%zu vertices, %s): %s\n", name.c_str(), n,
+                         reverse ? "clockwise" : "counter-clockwise", what);
+            return false;
+        };
+        if (tris.size() != (n - 2) * 3) return fail("wrong triangle count");
+        for (int i : tris) {
+            if (i < 0 || (size_t)i >= n) return fail("index out of range");
+        }
+
+        double area = 0;
+        for (size_t i = 0; i < n; ++i) area += signedArea({0, 0, 0}, poly[i], poly[(i + 1) % n]);
+        double orient = area < 0 ? -1 : 1;
+        // rounding can leave a sliver of collinear vertices slightly negative
+        double slack = 1e-9 * std::abs(area);
+        double sum = 0;
+        for (size_t t = 0; t < tris.size(); t += 3) {
+            double a = orient * signedArea(poly[tris[t]], poly[tris[t + 1]], poly[tris[t + 2]]);
+            if (a < -slack) return fail("triangle wound against the polygon");
+            sum += a;
+        }
+        if (std::abs(sum - std::abs(area)) > 1e-4 * std::abs(area)) return fail("triangle areas do not sum to the polygon area");
+        return true;
+    }
+}
+
+int main() {
+    struct Case {
+        const char* name;
+        int count;
+        std::vector<Vec3> (*make)(int);
+        int max;
+    };
+    const Case cases[] = {
+        {"star", 3000, randomStar, MAX_VERTICES},
+        {"spiral", 200, randomSpiral, MAX_VERTICES},
+        {"comb", 200, randomComb, MAX_VERTICES / 4},
+    };
+
+    int failed = 0;
+    for (const Case& c : cases) {
+        int passed = 0;
+        for (int i = 0; i < c.count; ++i) {
+            // the largest size is always tried once
+            std::vector<Vec3> pts = c.make(i == 0 ? c.max : randomCount(c.max));
+            if (check(c.name, pts, i % 2)) ++passed;
+            else ++failed;
+        }
+        std::printf("triangulate/%s\t%d/%d passed\n", c.name, passed, c.count);
+    }
+    return failed ? 1 : 0;
+}